@@ -0,0 +1,276 @@
+#include <cctype>
+#include "json.hpp"
+
+namespace calcd {
+
+namespace {
+
+class reader {
+public:
+    explicit reader(std::string_view text) : text_{ text }
+    { }
+
+    bool done() {
+        skip_whites();
+        return pos_ == text_.size();
+    }
+
+    bool consume(char ch) {
+        skip_whites();
+        if (pos_ == text_.size() || text_[pos_] != ch)
+            return false;
+        ++pos_;
+        return true;
+    }
+
+    char peek() {
+        skip_whites();
+        return (pos_ != text_.size()) ? text_[pos_] : '\0';
+    }
+
+    std::optional<std::string> read_string() {
+        if (!consume('"'))
+            return std::nullopt;
+
+        std::string res;
+        while (pos_ != text_.size()) {
+            auto ch = text_[pos_++];
+            if (ch == '"')
+                return res;
+            if (static_cast<unsigned char>(ch) < 0x20)
+                return std::nullopt;
+            if (ch != '\\') {
+                res.push_back(ch);
+                continue;
+            }
+            if (pos_ == text_.size())
+                return std::nullopt;
+
+            switch (text_[pos_++]) {
+            case '"':  res.push_back('"');  break;
+            case '\\': res.push_back('\\'); break;
+            case '/':  res.push_back('/');  break;
+            case 'b':  res.push_back('\b'); break;
+            case 'f':  res.push_back('\f'); break;
+            case 'n':  res.push_back('\n'); break;
+            case 'r':  res.push_back('\r'); break;
+            case 't':  res.push_back('\t'); break;
+            case 'u': {
+                auto cp = read_code_point();
+                if (!cp)
+                    return std::nullopt;
+                res.append(wide_to_utf8(std::wstring(1, static_cast<wchar_t>(*cp))));
+                break;
+            }
+            default:
+                return std::nullopt;
+            }
+        }
+        return std::nullopt;
+    }
+
+    std::optional<json_value> read_value() {
+        auto ch = peek();
+        if (ch == '"') {
+            auto str = read_string();
+            if (!str)
+                return std::nullopt;
+            return json_value{ json_value::kind_type::STRING, std::move(*str) };
+        }
+
+        auto begin = pos_;
+        while (pos_ != text_.size() && is_scalar_char(text_[pos_]))
+            ++pos_;
+        auto token = text_.substr(begin, pos_ - begin);
+        if (token == "true" || token == "false" || token == "null")
+            return json_value{ json_value::kind_type::LITERAL, std::string{ token } };
+        if (is_number(token))
+            return json_value{ json_value::kind_type::NUMBER, std::string{ token } };
+        return std::nullopt;
+    }
+
+private:
+    void skip_whites() {
+        while (pos_ != text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_])))
+            ++pos_;
+    }
+
+    std::optional<unsigned> read_hex4() {
+        if (text_.size() - pos_ < 4)
+            return std::nullopt;
+
+        unsigned res{ 0 };
+        for (auto i = 0; i < 4; ++i) {
+            auto ch = static_cast<unsigned char>(text_[pos_++]);
+            if (!std::isxdigit(ch))
+                return std::nullopt;
+            res = res * 16 + (std::isdigit(ch) ? ch - '0' : (std::tolower(ch) - 'a' + 10));
+        }
+        return res;
+    }
+
+    // \uXXXX, joined with the low half that must follow a high surrogate
+    std::optional<unsigned> read_code_point() {
+        auto hi = read_hex4();
+        if (!hi || (0xDC00 <= *hi && *hi < 0xE000))
+            return std::nullopt;
+        if (*hi < 0xD800 || 0xDC00 <= *hi)
+            return hi;
+
+        if (text_.substr(pos_, 2) != "\\u")
+            return std::nullopt;
+        pos_ += 2;
+        auto lo = read_hex4();
+        if (!lo || *lo < 0xDC00 || 0xE000 <= *lo)
+            return std::nullopt;
+        return 0x10000 + ((*hi - 0xD800) << 10) + (*lo - 0xDC00);
+    }
+
+    static bool is_scalar_char(char ch) noexcept {
+        return std::isalnum(static_cast<unsigned char>(ch)) || ch == '-' || ch == '+' || ch == '.';
+    }
+
+    static bool is_number(std::string_view token) noexcept {
+        size_t i{ 0 };
+        auto digits = [&]() {
+            auto from = i;
+            while (i < token.size() && std::isdigit(static_cast<unsigned char>(token[i])))
+                ++i;
+            return i > from;
+        };
+
+        if (i < token.size() && token[i] == '-')
+            ++i;
+        if (!digits())
+            return false;
+        if (i < token.size() && token[i] == '.') {
+            ++i;
+            if (!digits())
+                return false;
+        }
+        if (i < token.size() && (token[i] == 'e' || token[i] == 'E')) {
+            ++i;
+            if (i < token.size() && (token[i] == '+' || token[i] == '-'))
+                ++i;
+            if (!digits())
+                return false;
+        }
+        return i == token.size();
+    }
+
+private:
+    std::string_view text_;
+    size_t pos_{ 0 };
+};
+
+} // namespace
+
+std::optional<json_object> parse_object(std::string_view text) {
+    reader rd{ text };
+    json_object res;
+    if (!rd.consume('{'))
+        return std::nullopt;
+
+    if (!rd.consume('}')) {
+        do {
+            auto key = rd.read_string();
+            if (!key || !rd.consume(':'))
+                return std::nullopt;
+            auto value = rd.read_value();
+            if (!value)
+                return std::nullopt;
+            res.insert_or_assign(std::move(*key), std::move(*value));
+        } while (rd.consume(','));
+
+        if (!rd.consume('}'))
+            return std::nullopt;
+    }
+
+    if (!rd.done())
+        return std::nullopt;
+    return res;
+}
+
+void append_value(std::string &out, const json_value &value) {
+    if (value.kind == json_value::kind_type::STRING)
+        append_string(out, value.text);
+    else
+        out.append(value.text);
+}
+
+void append_string(std::string &out, std::string_view utf8) {
+    static constexpr char hex[] = "0123456789abcdef";
+
+    out.push_back('"');
+    for (auto ch : utf8) {
+        switch (ch) {
+        case '"':  out.append("\\\""); break;
+        case '\\': out.append("\\\\"); break;
+        case '\n': out.append("\\n");  break;
+        case '\r': out.append("\\r");  break;
+        case '\t': out.append("\\t");  break;
+        default:
+            if (static_cast<unsigned char>(ch) < 0x20) {
+                out.append("\\u00");
+                out.push_back(hex[(ch >> 4) & 0xF]);
+                out.push_back(hex[ch & 0xF]);
+            } else {
+                out.push_back(ch);
+            }
+            break;
+        }
+    }
+    out.push_back('"');
+}
+
+// Malformed sequences become U+FFFD, which no symbol or digit matches.
+std::wstring utf8_to_wide(std::string_view utf8) {
+    std::wstring res;
+    res.reserve(utf8.size());
+    for (size_t i = 0; i < utf8.size();) {
+        auto lead = static_cast<unsigned char>(utf8[i]);
+        auto len = (lead < 0x80) ? 1 : (lead >> 5) == 0x6 ? 2 : (lead >> 4) == 0xE ? 3 : (lead >> 3) == 0x1E ? 4 : 0;
+        if (!len || i + len > utf8.size()) {
+            res.push_back(L'\uFFFD');
+            ++i;
+            continue;
+        }
+
+        unsigned cp = (len == 1) ? lead : lead & (0x7F >> len);
+        auto valid{ true };
+        for (auto k = 1; k < len; ++k) {
+            auto cont = static_cast<unsigned char>(utf8[i + k]);
+            valid &= (cont >> 6) == 0x2;
+            cp = (cp << 6) | (cont & 0x3F);
+        }
+        res.push_back(valid ? static_cast<wchar_t>(cp) : L'\uFFFD');
+        i += valid ? len : 1;
+    }
+    return res;
+}
+
+std::string wide_to_utf8(std::wstring_view wide) {
+    std::string res;
+    res.reserve(wide.size());
+    for (auto wch : wide) {
+        auto cp = static_cast<unsigned>(wch);
+        if (cp < 0x80) {
+            res.push_back(static_cast<char>(cp));
+        } else if (cp < 0x800) {
+            res.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else if (cp < 0x10000) {
+            res.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            res.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        } else {
+            res.push_back(static_cast<char>(0xF0 | (cp >> 18)));
+            res.push_back(static_cast<char>(0x80 | ((cp >> 12) & 0x3F)));
+            res.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            res.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+    return res;
+}
+
+} // namespace calcd
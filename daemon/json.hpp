@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+
+namespace calcd {
+
+// Scalar member of a request. Strings are unescaped to UTF-8, numbers and
+// literals keep their source text.
+struct json_value {
+    enum class kind_type {
+        STRING,
+        NUMBER,
+        LITERAL
+    };
+
+    kind_type kind;
+    std::string text;
+};
+
+using json_object = std::unordered_map<std::string, json_value>;
+
+// Reads one object of scalar members; nested values, trailing characters
+// and malformed text give nullopt.
+std::optional<json_object> parse_object(std::string_view text);
+
+// Appends the value as JSON, quoting and escaping strings.
+void append_value(std::string &out, const json_value &value);
+void append_string(std::string &out, std::string_view utf8);
+
+std::wstring utf8_to_wide(std::string_view utf8);
+std::string wide_to_utf8(std::wstring_view wide);
+
+} // namespace calcd
@@ -0,0 +1,41 @@
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <thread>
+#include "server.hpp"
+
+namespace {
+
+calcd::server *instance{ nullptr };
+
+void on_signal(int) {
+    if (instance)
+        instance->stop();
+}
+
+} // namespace
+
+// calculatord [socket path] [worker threads]
+int main(int argc, char* argv[])
+{
+    std::string path = (argc > 1) ? argv[1] : "/tmp/calculatord.sock";
+    size_t threads = (argc > 2) 
+        ? std::strtoul(argv[2], nullptr, 10) 
+        : std::thread::hardware_concurrency();
+
+    try {
+        calcd::server srv{ path, threads };
+        instance = &srv;
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+        std::signal(SIGPIPE, SIG_IGN);
+
+        srv.run();
+        instance = nullptr;
+    }
+    catch (const std::exception &ex) {
+        std::cerr << "calculatord: " << ex.what() << '\n';
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,258 @@
+#include <cerrno>
+#include <charconv>
+#include <stdexcept>
+#include <system_error>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "model/batch.hpp"
+#include "json.hpp"
+#include "server.hpp"
+
+namespace calcd {
+
+namespace {
+
+const char* status_name(calculator::status_type st) noexcept {
+    using calculator::status_type;
+    switch (st) {
+    case status_type::OK:                   return "OK";
+    case status_type::UNKNOWN_ERROR:        return "UNKNOWN_ERROR";
+    case status_type::TOO_LONG_NUMBER:      return "TOO_LONG_NUMBER";
+    case status_type::INVALID_NUMBER:       return "INVALID_NUMBER";
+    case status_type::UNKNOWN_SYMBOL:       return "UNKNOWN_SYMBOL";
+    case status_type::PARTLY_INVALID_EXPR:  return "PARTLY_INVALID_EXPR";
+    case status_type::INVALID_EXPR:         return "INVALID_EXPR";
+    case status_type::INVALID_EVAL:         return "INVALID_EVAL";
+    case status_type::NUMBER_OVERFLOW:      return "NUMBER_OVERFLOW";
+    case status_type::INVALID_ARGUMENT:     return "INVALID_ARGUMENT";
+    case status_type::CANCELLED:            return "CANCELLED";
+    }
+    return "UNKNOWN_ERROR";
+}
+
+const char* symbol_name(calculator::symbol_type st) noexcept {
+    using calculator::symbol_type;
+    switch (st) {
+    case symbol_type::ADD:      return "ADD";
+    case symbol_type::MULT:     return "MULT";
+    case symbol_type::DIV:      return "DIV";
+    case symbol_type::POW:      return "POW";
+    case symbol_type::MINUS:    return "MINUS";
+    case symbol_type::FACT:     return "FACT";
+    case symbol_type::MOD:      return "MOD";
+    case symbol_type::COS:      return "COS";
+    case symbol_type::SIN:      return "SIN";
+    case symbol_type::TAN:      return "TAN";
+    case symbol_type::ACOS:     return "ACOS";
+    case symbol_type::ASIN:     return "ASIN";
+    case symbol_type::ATAN:     return "ATAN";
+    case symbol_type::LG:       return "LG";
+    case symbol_type::LN:       return "LN";
+    case symbol_type::SQRT:     return "SQRT";
+    case symbol_type::PI:       return "PI";
+    case symbol_type::E:        return "E";
+    default:                    return "UNKNOWN";
+    }
+}
+
+// integer member within [min, max], def when absent, nullopt when invalid
+std::optional<int> read_int(const json_object &req, const std::string &key, int def, int min, int max) {
+    auto it = req.find(key);
+    if (it == req.end())
+        return def;
+    if (it->second.kind != json_value::kind_type::NUMBER)
+        return std::nullopt;
+
+    auto &text = it->second.text;
+    int res{ 0 };
+    auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), res);
+    if (ec != std::errc{} || ptr != text.data() + text.size() || res < min || res > max)
+        return std::nullopt;
+    return res;
+}
+
+std::string begin_response(const json_object *req) {
+    std::string res{ "{\"id\":" };
+    auto id = req ? req->find("id") : json_object::const_iterator{};
+    if (req && id != req->end())
+        append_value(res, id->second);
+    else
+        res.append("null");
+    return res;
+}
+
+std::string error_response(const json_object *req, std::string_view message) {
+    auto res = begin_response(req);
+    res.append(",\"error\":");
+    append_string(res, message);
+    res.push_back('}');
+    return res;
+}
+
+} // namespace
+
+struct server::connection {
+    int fd;
+    std::mutex write_mutex;
+    bool broken{ false };
+
+    explicit connection(int fd) : fd{ fd }
+    { }
+
+    // Writes whole lines, so responses of concurrent tasks never interleave.
+    void send(const std::string &line) {
+        std::lock_guard lock{ write_mutex };
+        size_t sent{ 0 };
+        while (!broken && sent < line.size()) {
+            auto n = ::send(fd, line.data() + sent, line.size() - sent, MSG_NOSIGNAL);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                broken = true;
+            else
+                sent += static_cast<size_t>(n);
+        }
+    }
+
+    ~connection() {
+        ::close(fd);
+    }
+};
+
+server::server(std::string path, size_t threads) : 
+    path_{ std::move(path) },
+    pool_{ threads }
+{
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (path_.size() >= sizeof(addr.sun_path))
+        throw std::invalid_argument("socket path is too long");
+    path_.copy(addr.sun_path, path_.size());
+
+    listen_fd_ = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd_ < 0)
+        throw std::system_error(errno, std::generic_category(), "socket");
+
+    ::unlink(path_.c_str());
+    if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || 
+        ::listen(listen_fd_, SOMAXCONN) < 0) {
+        auto err = errno;
+        ::close(listen_fd_);
+        throw std::system_error(err, std::generic_category(), "bind " + path_);
+    }
+}
+
+void server::run() {
+    while (!stopped_) {
+        auto fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED)
+                continue;
+            break;
+        }
+
+        {
+            std::lock_guard lock{ readers_mutex_ };
+            readers_.insert(fd);
+        }
+        std::thread{ [this, conn = std::make_shared<connection>(fd)]() { serve(conn); } }.detach();
+    }
+
+    std::unique_lock lock{ readers_mutex_ };
+    for (auto fd : readers_)
+        ::shutdown(fd, SHUT_RD);
+    readers_cv_.wait(lock, [this]() { return readers_.empty(); });
+}
+
+void server::stop() noexcept {
+    stopped_ = true;
+    ::shutdown(listen_fd_, SHUT_RDWR);
+}
+
+// Splits the stream into lines and hands each to the pool. A line over
+// k_max_line is answered with an error and ends the connection.
+void server::serve(std::shared_ptr<connection> conn) {
+    std::string buffer;
+    char chunk[1 << 14];
+    while (!stopped_) {
+        auto n = ::read(conn->fd, chunk, sizeof(chunk));
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            break;
+
+        buffer.append(chunk, static_cast<size_t>(n));
+        size_t begin{ 0 };
+        for (auto end = buffer.find('\n'); end != std::string::npos; end = buffer.find('\n', begin)) {
+            auto line = buffer.substr(begin, end - begin);
+            begin = end + 1;
+            if (line.empty() || line == "\r")
+                continue;
+            pool_.submit([conn, line = std::move(line)]() {
+                conn->send(handle(line).append(1, '\n'));
+            });
+        }
+        buffer.erase(0, begin);
+
+        if (buffer.size() > k_max_line) {
+            conn->send(error_response(nullptr, "request line is too long").append(1, '\n'));
+            break;
+        }
+    }
+
+    // the socket leaves the set while it is still open, so that run() never
+    // shuts down a descriptor reused by another file
+    {
+        std::lock_guard lock{ readers_mutex_ };
+        readers_.erase(conn->fd);
+        if (readers_.empty())
+            readers_cv_.notify_all();
+    }
+}
+
+std::string server::handle(std::string_view line) {
+    auto req = parse_object(line);
+    if (!req)
+        return error_response(nullptr, "malformed request");
+
+    auto expr = req->find("expr");
+    if (expr == req->end() || expr->second.kind != json_value::kind_type::STRING)
+        return error_response(&*req, "\"expr\" must be a string");
+
+    auto prec = read_int(*req, "precision", k_default_precision, 2, k_max_precision);
+    if (!prec)
+        return error_response(&*req, "\"precision\" must be an integer in [2, 1048576]");
+
+    auto digits = read_int(*req, "digits", k_default_digits, 1, k_max_digits);
+    if (!digits)
+        return error_response(&*req, "\"digits\" must be an integer in [1, 65536]");
+
+    try {
+        auto [num, st, op] = calculator::eval_one(utf8_to_wide(expr->second.text), *prec);
+
+        auto res = begin_response(&*req);
+        res.append(",\"status\":\"").append(status_name(st)).append("\"");
+        if (st == calculator::status_type::OK) {
+            static thread_local std::wstring text;
+            calculator::convert_to_wstring(num, *digits, text);
+            res.append(",\"result\":");
+            append_string(res, wide_to_utf8(text));
+        }
+        else if (op) {
+            res.append(",\"op\":\"").append(symbol_name(op->type())).append("\"");
+        }
+        res.push_back('}');
+        return res;
+    }
+    catch (const std::exception &ex) {
+        return error_response(&*req, ex.what());
+    }
+}
+
+server::~server() {
+    ::close(listen_fd_);
+    ::unlink(path_.c_str());
+}
+
+} // namespace calcd
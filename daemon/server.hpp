@@ -0,0 +1,62 @@
+#pragma once
+
+#include <mutex>
+#include <thread>
+#include <unordered_set>
+#include <condition_variable>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "model/thread_pool.hpp"
+
+namespace calcd {
+
+// Evaluates JSON-lines requests from clients of a Unix domain socket.
+// A request is an object with "expr" and optionally "id", "precision" (in
+// bits) and "digits"; every line is evaluated as its own pool task, so a
+// client may send many before reading and receives the responses in the
+// order they finish, each carrying the id of its request.
+class server {
+public:
+    static constexpr int k_default_precision = 1 << 8;
+    static constexpr int k_max_precision = 1 << 20;
+    static constexpr int k_default_digits = 15;
+    static constexpr int k_max_digits = 1 << 16;
+    static constexpr size_t k_max_line = 1 << 20;
+
+public:
+    server() = delete;
+    server(std::string path, size_t threads);
+    server(const server&) = delete;
+    server& operator=(const server&) = delete;
+
+    // Accepts clients until stop() is called.
+    void run();
+    // Safe to call from a signal handler.
+    void stop() noexcept;
+
+    // The response line to one request line, without the newline.
+    static std::string handle(std::string_view line);
+
+    ~server();
+
+private:
+    struct connection;
+
+    void serve(std::shared_ptr<connection> conn);
+
+private:
+    std::string path_;
+    int listen_fd_{ -1 };
+    std::atomic<bool> stopped_{ false };
+
+    // sockets of the clients still being read, shut down by run() on stop
+    std::mutex readers_mutex_;
+    std::condition_variable readers_cv_;
+    std::unordered_set<int> readers_;
+
+    calculator::thread_pool pool_;
+};
+
+} // namespace calcd
@@ -1,11 +1,23 @@
 #include <QApplication>
+#include <QTimer>
 #include "view/mainwindow.hpp"
+#include "view/startupprofile.hpp"
 
 int main(int argc, char* argv[])
 {
+    auto& profile = StartupProfile::instance();
     QApplication a(argc, argv);
+    profile.mark("application");
     Presenter presenter;
+    profile.mark("presenter");
     MainWindow w{ presenter };
+    profile.mark("window");
     w.show();
+    profile.mark("show");
+    // runs after the paint events show() has posted
+    QTimer::singleShot(0, [&profile]() {
+        profile.mark("first paint");
+        profile.report();
+    });
     return a.exec();
 }
\ No newline at end of file
@@ -0,0 +1,65 @@
+#include <sstream>
+#include <algorithm>
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "eval.hpp"
+#include "batch.hpp"
+
+namespace calculator {
+
+namespace {
+
+// Tasks per worker: enough to let stealing even out uneven expressions
+// without paying a queue round-trip for every item.
+constexpr size_t k_chunks_per_worker = 8;
+
+struct worker_state {
+    std::wistringstream source;
+};
+
+worker_state& local_state() {
+    static thread_local worker_state state;
+    return state;
+}
+
+} // namespace
+
+std::tuple<number_t, status_type, op_ptr> eval_one(const std::wstring &expr, int prec) {
+    auto &source = local_state().source;
+    source.clear();
+    source.str(expr);
+
+    auto [obj, st] = parse(lexer(source, std::max(1, prec / 4)));
+    if (st != status_type::PARTLY_INVALID_EXPR)
+        return { 0, st, nullptr };
+
+    return eval(obj, prec);
+}
+
+std::vector<std::tuple<number_t, status_type, op_ptr>> eval_many(
+    std::span<const std::wstring> exprs, 
+    thread_pool &pool, 
+    int prec
+) {
+    std::vector<std::tuple<number_t, status_type, op_ptr>> results(exprs.size());
+    if (exprs.empty())
+        return results;
+
+    auto chunk = std::max<size_t>(1, exprs.size() / (pool.size() * k_chunks_per_worker));
+    number_defaults defaults;
+
+    task_group group{ pool };
+    for (size_t begin = 0; begin < exprs.size(); begin += chunk) {
+        auto end = std::min(begin + chunk, exprs.size());
+        group.run([&, begin, end]() {
+            defaults.apply();
+            for (auto i = begin; i < end; ++i)
+                results[i] = eval_one(exprs[i], prec);
+        });
+    }
+    group.wait();
+
+    return results;
+}
+
+} // namespace calculator
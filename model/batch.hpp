@@ -0,0 +1,27 @@
+#pragma once
+
+#include <span>
+#include <tuple>
+#include <string>
+#include <vector>
+#include "op.hpp"
+#include "status.hpp"
+#include "number.hpp"
+#include "thread_pool.hpp"
+
+namespace calculator {
+
+// Lexes, parses and evaluates one expression, reading it through a stream
+// the calling thread keeps for all its expressions.
+std::tuple<number_t, status_type, op_ptr> eval_one(const std::wstring &expr, int prec = 1 << 6);
+
+// Lexes, parses and evaluates independent expressions on the pool's workers.
+// Numbers are read with `prec` bits, results come back in input order. The
+// pool outlives the call, so repeated batches don't start threads again.
+std::vector<std::tuple<number_t, status_type, op_ptr>> eval_many(
+	std::span<const std::wstring> exprs,
+	thread_pool& pool,
+	int prec = 1 << 6
+);
+
+} // namespace calculator
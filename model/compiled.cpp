@@ -0,0 +1,540 @@
+#include <cmath>
+#include <array>
+#include <atomic>
+#include <stack>
+#include <algorithm>
+#include "lexer.hpp"
+#include "parser.hpp"
+#include "compiled.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define CALCULATOR_X86_DISPATCH
+#include <immintrin.h>
+#endif
+
+namespace calculator {
+
+namespace {
+
+// Points evaluated together; one block of every register fits in L1/L2.
+constexpr size_t k_block = 256;
+const double k_max_value = 1e+100;
+
+using lane_status = std::array<status_type, k_block>;
+using lane_isa = compiled_expr::lane_isa;
+
+std::atomic<lane_isa> lane_limit{ lane_isa::AVX512 };
+
+lane_isa detect_isa() {
+#ifdef CALCULATOR_X86_DISPATCH
+    static const lane_isa isa = []() {
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx512f"))
+            return lane_isa::AVX512;
+        if (__builtin_cpu_supports("avx2"))
+            return lane_isa::AVX2;
+        return lane_isa::SCALAR;
+    }();
+    return std::min(isa, lane_limit.load(std::memory_order_relaxed));
+#else
+    return lane_isa::SCALAR;
+#endif
+}
+
+#define DECLARE_BINARY_KERNEL(name, expr) \
+void name##_scalar(double *a, const double *b, size_t n) { \
+    for (size_t i = 0; i < n; ++i) \
+        a[i] = a[i] expr b[i]; \
+}
+#define DECLARE_UNARY_KERNEL(name, func) \
+void name##_scalar(double *a, size_t n) { \
+    for (size_t i = 0; i < n; ++i) \
+        a[i] = func(a[i]); \
+}
+
+DECLARE_BINARY_KERNEL(add, +)
+DECLARE_BINARY_KERNEL(mul, *)
+DECLARE_BINARY_KERNEL(div, /)
+DECLARE_UNARY_KERNEL(sqrt, std::sqrt)
+
+#ifdef CALCULATOR_X86_DISPATCH
+
+#define DECLARE_SIMD_BINARY_KERNEL(name, isa, arch, width, load, store, op) \
+__attribute__((target(arch))) void name##_##isa(double *a, const double *b, size_t n) { \
+    size_t i = 0; \
+    for (; i + width <= n; i += width) \
+        store(a + i, op(load(a + i), load(b + i))); \
+    name##_scalar(a + i, b + i, n - i); \
+}
+#define DECLARE_SIMD_UNARY_KERNEL(name, isa, arch, width, load, store, op) \
+__attribute__((target(arch))) void name##_##isa(double *a, size_t n) { \
+    size_t i = 0; \
+    for (; i + width <= n; i += width) \
+        store(a + i, op(load(a + i))); \
+    name##_scalar(a + i, n - i); \
+}
+
+// AVX-512 reads the tail through a lane mask instead of the scalar loop.
+// The zero-masked forms leave no lane undefined.
+#define DECLARE_AVX512_BINARY_KERNEL(name, op) \
+__attribute__((target("avx512f"))) void name##_avx512(double *a, const double *b, size_t n) { \
+    for (size_t i = 0; i < n; i += 8) { \
+        auto mask = static_cast<__mmask8>((n - i >= 8) ? 0xFF : (1u << (n - i)) - 1); \
+        auto x = _mm512_maskz_loadu_pd(mask, a + i); \
+        auto y = _mm512_maskz_loadu_pd(mask, b + i); \
+        _mm512_mask_storeu_pd(a + i, mask, op(mask, x, y)); \
+    } \
+}
+#define DECLARE_AVX512_UNARY_KERNEL(name, op) \
+__attribute__((target("avx512f"))) void name##_avx512(double *a, size_t n) { \
+    for (size_t i = 0; i < n; i += 8) { \
+        auto mask = static_cast<__mmask8>((n - i >= 8) ? 0xFF : (1u << (n - i)) - 1); \
+        auto x = _mm512_maskz_loadu_pd(mask, a + i); \
+        _mm512_mask_storeu_pd(a + i, mask, op(mask, x)); \
+    } \
+}
+
+DECLARE_SIMD_BINARY_KERNEL(add, avx2, "avx2", 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_add_pd)
+DECLARE_SIMD_BINARY_KERNEL(mul, avx2, "avx2", 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_mul_pd)
+DECLARE_SIMD_BINARY_KERNEL(div, avx2, "avx2", 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_div_pd)
+DECLARE_SIMD_UNARY_KERNEL(sqrt, avx2, "avx2", 4, _mm256_loadu_pd, _mm256_storeu_pd, _mm256_sqrt_pd)
+
+DECLARE_AVX512_BINARY_KERNEL(add, _mm512_maskz_add_pd)
+DECLARE_AVX512_BINARY_KERNEL(mul, _mm512_maskz_mul_pd)
+DECLARE_AVX512_BINARY_KERNEL(div, _mm512_maskz_div_pd)
+DECLARE_AVX512_UNARY_KERNEL(sqrt, _mm512_maskz_sqrt_pd)
+
+#define DISPATCH_KERNEL(name, isa, ...) \
+    switch (isa) \
+    { \
+    case lane_isa::AVX512: name##_avx512(__VA_ARGS__); break; \
+    case lane_isa::AVX2: name##_avx2(__VA_ARGS__); break; \
+    default: name##_scalar(__VA_ARGS__); break; \
+    }
+
+#else
+
+#define DISPATCH_KERNEL(name, isa, ...) name##_scalar(__VA_ARGS__);
+
+#endif
+
+bool is_integer(double v) {
+    return std::isfinite(v) && std::trunc(v) == v;
+}
+
+// Mirrors mpfr::mod, which the MOD operation is built on.
+double mod(double x, double y) {
+    if (y == 0)
+        return x;
+    if (x == y)
+        return 0;
+    auto m = x - std::floor(x / y) * y;
+    return std::copysign(std::abs(m), y);
+}
+
+template<typename Func>
+void for_lanes(double *a, size_t n, Func &&func) {
+    for (size_t i = 0; i < n; ++i)
+        a[i] = func(a[i]);
+}
+
+template<typename Func>
+void for_lanes(double *a, const double *b, size_t n, Func &&func) {
+    for (size_t i = 0; i < n; ++i)
+        a[i] = func(a[i], b[i]);
+}
+
+void apply_unary(lane_isa isa, symbol_type type, double *a, size_t n, lane_status &st) {
+    switch (type)
+    {
+    case symbol_type::MINUS:    for_lanes(a, n, [](double v) { return -v; });                  break;
+    case symbol_type::SQRT:     DISPATCH_KERNEL(sqrt, isa, a, n)                                break;
+    case symbol_type::COS:      for_lanes(a, n, [](double v) { return std::cos(v); });         break;
+    case symbol_type::SIN:      for_lanes(a, n, [](double v) { return std::sin(v); });         break;
+    case symbol_type::TAN:      for_lanes(a, n, [](double v) { return std::tan(v); });         break;
+    case symbol_type::ACOS:     for_lanes(a, n, [](double v) { return std::acos(v); });        break;
+    case symbol_type::ASIN:     for_lanes(a, n, [](double v) { return std::asin(v); });        break;
+    case symbol_type::ATAN:     for_lanes(a, n, [](double v) { return std::atan(v); });        break;
+    case symbol_type::LN:       for_lanes(a, n, [](double v) { return std::log(v); });         break;
+    case symbol_type::LG:       for_lanes(a, n, [](double v) { return std::log10(v); });       break;
+    case symbol_type::FACT:
+        for (size_t i = 0; i < n; ++i) {
+            auto arg = a[i];
+            a[i] = 0;
+            if (!is_integer(arg)) {
+                st[i] = status_type::INVALID_ARGUMENT;
+                continue;
+            }
+            double res{ 1 };
+            for (double k = 1; k <= arg && st[i] == status_type::OK; ++k) {
+                res *= k;
+                if (res > k_max_value)
+                    st[i] = status_type::NUMBER_OVERFLOW;
+            }
+            if (st[i] == status_type::OK)
+                a[i] = res;
+        }
+        break;
+    default:
+        std::fill(st.begin(), st.begin() + n, status_type::INVALID_EVAL);
+        break;
+    }
+}
+
+void apply_binary(lane_isa isa, symbol_type type, double *a, const double *b, size_t n, lane_status &st) {
+    switch (type)
+    {
+    case symbol_type::ADD:      DISPATCH_KERNEL(add, isa, a, b, n)                              break;
+    case symbol_type::MULT:     DISPATCH_KERNEL(mul, isa, a, b, n)                              break;
+    case symbol_type::DIV:      DISPATCH_KERNEL(div, isa, a, b, n)                              break;
+    case symbol_type::POW:      for_lanes(a, b, n, [](double x, double y) { return std::pow(x, y); }); break;
+    case symbol_type::MOD:
+        for (size_t i = 0; i < n; ++i) {
+            if (!is_integer(a[i]) || !is_integer(b[i])) {
+                st[i] = status_type::INVALID_ARGUMENT;
+                a[i] = 0;
+                continue;
+            }
+            a[i] = mod(a[i], b[i]);
+        }
+        break;
+    default:
+        std::fill(st.begin(), st.begin() + n, status_type::INVALID_EVAL);
+        break;
+    }
+}
+
+// Same checks, in the same order, as operation::exec does for each result.
+// Doubles overflow long before MPFR does, so lanes that became infinite from
+// finite arguments are recomputed through the operation itself.
+void check_lanes(
+    const operation &op,
+    double *a,
+    const double *lhs,
+    const double *rhs,
+    size_t n,
+    const lane_status &op_status,
+    std::span<status_type> statuses
+) {
+    for (size_t i = 0; i < n; ++i) {
+        if (statuses[i] != status_type::OK)
+            continue;
+
+        if (op_status[i] != status_type::OK) {
+            statuses[i] = op_status[i];
+            continue;
+        }
+
+        if (std::isinf(a[i]) && std::isfinite(lhs[i]) && (!rhs || std::isfinite(rhs[i]))) {
+            std::vector<number_t> args{ number_t{ lhs[i] } };
+            if (rhs)
+                args.emplace_back(rhs[i]);
+            auto [res, status] = op.exec(args);
+            statuses[i] = status;
+            a[i] = res.toDouble();
+            continue;
+        }
+
+        if (!std::isfinite(a[i]))
+            statuses[i] = status_type::INVALID_ARGUMENT;
+        else if (a[i] > k_max_value)
+            statuses[i] = status_type::NUMBER_OVERFLOW;
+    }
+}
+
+void assign(double &dst, const number_t &src) {
+    dst = src.toDouble();
+}
+
+void assign(number_t &dst, const number_t &src) {
+    dst = src;
+}
+
+void assign_nan(double &dst) {
+    dst = std::numeric_limits<double>::quiet_NaN();
+}
+
+void assign_nan(number_t &dst) {
+    dst.setNan();
+}
+
+} // namespace
+
+compiled_expr::compiled_expr(const object_t &obj, size_t variables, int prec) :
+    variables_{ variables },
+    prec_{ prec }
+{
+    lower(obj);
+
+    native_constants_.reserve(constants_.size());
+    for (auto &c : constants_)
+        native_constants_.push_back(c.toDouble());
+}
+
+std::pair<compiled_expr, status_type> compiled_expr::compile(
+    const std::wstring &expr,
+    const std::vector<std::wstring> &variables,
+    int prec
+) {
+    if (!lexer::are_valid_variables(variables))
+        return { compiled_expr{}, status_type::UNKNOWN_SYMBOL };
+
+    auto [obj, st] = parse(lexer(expr, std::max(1, prec / 4), variables));
+    if (st != status_type::PARTLY_INVALID_EXPR)
+        return { compiled_expr{}, st };
+
+    return { compiled_expr{ obj, variables.size(), prec }, status_type::OK };
+}
+
+compiled_expr::lane_isa compiled_expr::lanes() noexcept {
+    return detect_isa();
+}
+
+void compiled_expr::limit_lanes(lane_isa widest) noexcept {
+    lane_limit.store(widest, std::memory_order_relaxed);
+}
+
+size_t compiled_expr::variables() const noexcept {
+    return variables_;
+}
+
+size_t compiled_expr::max_depth() const noexcept {
+    return max_depth_;
+}
+
+int compiled_expr::precision() const noexcept {
+    return prec_;
+}
+
+bool compiled_expr::is_native() const noexcept {
+    return prec_ <= kNativePrecision;
+}
+
+status_type compiled_expr::eval(columns_t<double> bindings, std::span<double> out, std::span<status_type> statuses) const {
+    if (!fits(bindings, out.size(), statuses.size()))
+        return status_type::INVALID_ARGUMENT;
+
+    if (is_native())
+        eval_native(bindings, out, statuses);
+    else
+        eval_mpfr(bindings, out, statuses);
+    return status_type::OK;
+}
+
+status_type compiled_expr::eval(columns_t<number_t> bindings, std::span<number_t> out, std::span<status_type> statuses) const {
+    if (!fits(bindings, out.size(), statuses.size()))
+        return status_type::INVALID_ARGUMENT;
+
+    eval_mpfr(bindings, out, statuses);
+    return status_type::OK;
+}
+
+template<typename T>
+bool compiled_expr::fits(columns_t<T> bindings, size_t points, size_t statuses) const noexcept {
+    if (bindings.size() != variables_ || statuses != points)
+        return false;
+    return std::all_of(bindings.begin(), bindings.end(), [points](auto &&column) {
+        return column.size() == points;
+    });
+}
+
+// Follows program::lower frame by frame: operands are pushed, operators
+// reduce by priority and every bracket leaves exactly its top value. Errors
+// that do not depend on values become FAIL at the point eval would stop.
+void compiled_expr::lower(const object_t &obj) {
+    struct frame {
+        const std::vector<object_t> *childs;
+        size_t i;
+        std::stack<op_ptr> ops;
+        size_t depth;
+    };
+
+    size_t depth{ 0 };
+    auto push = [&](frame &f) {
+        ++f.depth;
+        max_depth_ = std::max(max_depth_, ++depth);
+    };
+
+    auto reduce = [&](frame &f, int priority) {
+        while(!f.ops.empty() && f.ops.top()->priority() >= priority) {
+            auto op = f.ops.top(); f.ops.pop();
+            auto args = static_cast<size_t>(op->category());
+            if (f.depth < args) {
+                emit(instr_type::FAIL, static_cast<size_t>(status_type::INVALID_EVAL), op);
+                return false;
+            }
+            emit(args == 1 ? instr_type::UNARY : instr_type::BINARY, 0, op);
+            f.depth -= args - 1;
+            depth -= args - 1;
+        }
+        return true;
+    };
+
+    std::stack<frame> frames;
+    frames.push({ std::any_cast<std::vector<object_t>>(&obj.value), 0, {}, 0 });
+
+    while(!frames.empty()) {
+        auto &f = frames.top();
+        if (f.i < f.childs->size()) {
+            auto &o = (*f.childs)[f.i++];
+            switch (o.type)
+            {
+            case object_type::EXPR:
+                frames.push({ std::any_cast<std::vector<object_t>>(&o.value), 0, {}, 0 });
+                break;
+            case object_type::OPERAND:
+                {
+                    constants_.push_back(std::any_cast<constant>(&o.value)->at(prec_));
+                    emit(instr_type::CONSTANT, constants_.size() - 1);
+                    push(f);
+                }
+                break;
+            case object_type::VARIABLE:
+                emit(instr_type::VARIABLE, std::any_cast<size_t>(o.value));
+                push(f);
+                break;
+            case object_type::OPERATOR:
+                {
+                    auto op = std::any_cast<op_ptr>(o.value);
+                    if (!reduce(f, op->priority()))
+                        return;
+                    f.ops.push(op);
+                }
+                break;
+            default:
+                break;
+            }
+            continue;
+        }
+
+        if (!reduce(f, std::numeric_limits<int>::min()))
+            return;
+
+        if (!f.depth) {
+            emit(instr_type::FAIL, static_cast<size_t>(status_type::INVALID_EVAL));
+            return;
+        }
+
+        if (f.depth > 1) {
+            emit(instr_type::KEEP_TOP, f.depth - 1);
+            depth -= f.depth - 1;
+        }
+
+        frames.pop();
+        if (!frames.empty())
+            ++frames.top().depth;
+    }
+}
+
+void compiled_expr::emit(instr_type type, size_t arg, op_ptr op) {
+    code_.push_back({ type, arg, std::move(op) });
+}
+
+void compiled_expr::eval_native(columns_t<double> bindings, std::span<double> out, std::span<status_type> statuses) const {
+    auto isa = detect_isa();
+    std::vector<double> regs(std::max<size_t>(max_depth_, 1) * k_block);
+    auto reg = [&regs](size_t id) { return regs.data() + id * k_block; };
+
+    lane_status op_status;
+    std::array<double, k_block> lhs;
+    for (size_t base = 0; base < out.size(); base += k_block) {
+        auto n = std::min(k_block, out.size() - base);
+        auto st = statuses.subspan(base, n);
+        std::fill(st.begin(), st.end(), status_type::OK);
+
+        size_t sp{ 0 };
+        for (auto &in : code_) {
+            switch (in.type)
+            {
+            case instr_type::CONSTANT:
+                std::fill_n(reg(sp++), n, native_constants_[in.arg]);
+                break;
+            case instr_type::VARIABLE:
+                std::copy_n(bindings[in.arg].data() + base, n, reg(sp++));
+                break;
+            case instr_type::UNARY:
+                op_status.fill(status_type::OK);
+                std::copy_n(reg(sp - 1), n, lhs.begin());
+                apply_unary(isa, in.op->type(), reg(sp - 1), n, op_status);
+                check_lanes(*in.op, reg(sp - 1), lhs.data(), nullptr, n, op_status, st);
+                break;
+            case instr_type::BINARY:
+                op_status.fill(status_type::OK);
+                std::copy_n(reg(sp - 2), n, lhs.begin());
+                apply_binary(isa, in.op->type(), reg(sp - 2), reg(sp - 1), n, op_status);
+                check_lanes(*in.op, reg(sp - 2), lhs.data(), reg(sp - 1), n, op_status, st);
+                --sp;
+                break;
+            case instr_type::KEEP_TOP:
+                std::copy_n(reg(sp - 1), n, reg(sp - 1 - in.arg));
+                sp -= in.arg;
+                break;
+            case instr_type::FAIL:
+                for (auto &s : st)
+                    if (s == status_type::OK)
+                        s = static_cast<status_type>(in.arg);
+                break;
+            }
+        }
+
+        for (size_t i = 0; i < n; ++i) {
+            if (st[i] == status_type::OK)
+                out[base + i] = reg(sp - 1)[i];
+            else
+                assign_nan(out[base + i]);
+        }
+    }
+}
+
+template<typename T, typename Out>
+void compiled_expr::eval_mpfr(columns_t<T> bindings, std::span<Out> out, std::span<status_type> statuses) const {
+    std::vector<number_t> regs(std::max<size_t>(max_depth_, 1));
+    std::vector<number_t> args;
+
+    for (size_t i = 0; i < out.size(); ++i) {
+        auto &st = statuses[i];
+        st = status_type::OK;
+
+        size_t sp{ 0 };
+        for (auto &in : code_) {
+            switch (in.type)
+            {
+            case instr_type::CONSTANT:
+                regs[sp++] = constants_[in.arg];
+                break;
+            case instr_type::VARIABLE:
+                regs[sp] = number_t{ bindings[in.arg][i] };
+                regs[sp++].set_prec(prec_);
+                break;
+            case instr_type::UNARY:
+            case instr_type::BINARY:
+                {
+                    auto count = static_cast<size_t>(in.op->category());
+                    args.assign(regs.begin() + (sp - count), regs.begin() + sp);
+                    auto [res, status] = in.op->exec(args);
+                    st = status;
+                    sp -= count - 1;
+                    regs[sp - 1] = std::move(res);
+                }
+                break;
+            case instr_type::KEEP_TOP:
+                regs[sp - 1 - in.arg] = regs[sp - 1];
+                sp -= in.arg;
+                break;
+            case instr_type::FAIL:
+                st = static_cast<status_type>(in.arg);
+                break;
+            }
+
+            if (st != status_type::OK)
+                break;
+        }
+
+        if (st == status_type::OK)
+            assign(out[i], regs[sp - 1]);
+        else
+            assign_nan(out[i]);
+    }
+}
+
+} // namespace calculator
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <span>
+#include <string>
+#include <vector>
+#include <limits>
+#include <utility>
+#include "object.hpp"
+#include "op.hpp"
+#include "status.hpp"
+#include "number.hpp"
+
+namespace calculator {
+
+// One column per variable, all of the same length (structure of arrays).
+template<typename T>
+using columns_t = std::span<const std::span<const T>>;
+
+// Expression lowered to a postfix program that can be evaluated over many
+// variable bindings at once. Up to double precision points are computed in
+// SIMD double lanes, wider precisions go through MPFR with the same
+// operations the tree evaluator uses. Points that fail get NaN and their
+// own status.
+//
+// The double path works in IEEE doubles whatever precision up to 53 bits was
+// asked for: constants are rounded to double and functions come from the C
+// library, so results may differ from eval's in the last bits. Only overflow
+// is recomputed through MPFR. Ask for more than kNativePrecision bits when
+// the results have to match eval exactly.
+class compiled_expr {
+public:
+    static constexpr int kNativePrecision = std::numeric_limits<double>::digits;
+
+    // SIMD extensions of the double path, from the narrowest.
+    enum class lane_isa {
+        SCALAR,
+        AVX2,
+        AVX512
+    };
+
+public:
+    compiled_expr() = default;
+    compiled_expr(const object_t &obj, size_t variables, int prec);
+
+    static std::pair<compiled_expr, status_type> compile(
+        const std::wstring &expr,
+        const std::vector<std::wstring> &variables,
+        int prec = 1 << 6
+    );
+
+    // Widest extension the double path uses: the CPU's best unless limited.
+    // Limiting it lets the kernels be checked against each other.
+    static lane_isa lanes() noexcept;
+    static void limit_lanes(lane_isa widest) noexcept;
+
+    size_t variables() const noexcept;
+    size_t max_depth() const noexcept;
+    int precision() const noexcept;
+    bool is_native() const noexcept;
+
+    // Every binding column and the statuses must have one entry per point of
+    // out, with a column per variable; otherwise nothing is evaluated and
+    // INVALID_ARGUMENT is returned.
+    status_type eval(columns_t<double> bindings, std::span<double> out, std::span<status_type> statuses) const;
+    status_type eval(columns_t<number_t> bindings, std::span<number_t> out, std::span<status_type> statuses) const;
+
+private:
+    enum class instr_type {
+        CONSTANT,
+        VARIABLE,
+        UNARY,
+        BINARY,
+        KEEP_TOP,
+        FAIL
+    };
+
+    struct instruction {
+        instr_type type;
+        size_t arg;
+        op_ptr op;
+    };
+
+    void lower(const object_t &obj);
+    void emit(instr_type type, size_t arg = 0, op_ptr op = nullptr);
+
+    template<typename T>
+    bool fits(columns_t<T> bindings, size_t points, size_t statuses) const noexcept;
+
+    void eval_native(columns_t<double> bindings, std::span<double> out, std::span<status_type> statuses) const;
+
+    template<typename T, typename Out>
+    void eval_mpfr(columns_t<T> bindings, std::span<Out> out, std::span<status_type> statuses) const;
+
+private:
+    std::vector<instruction> code_;
+    std::vector<number_t> constants_;
+    std::vector<double> native_constants_;
+    size_t variables_{ 0 };
+    size_t max_depth_{ 0 };
+    int prec_{ kNativePrecision };
+};
+
+} // namespace calculator
@@ -0,0 +1,68 @@
+#include <cmath>
+#include <stack>
+#include <algorithm>
+#include "eval.hpp"
+#include "digits.hpp"
+
+namespace calculator {
+
+digit_expansion::digit_expansion(object_t expr) :
+    expr_{ std::move(expr) }
+{
+    std::stack<const object_t*> pending;
+    pending.push(&expr_);
+    while (!pending.empty()) {
+        auto o = pending.top();
+        pending.pop();
+        if (o->type == object_type::EXPR) {
+            for (auto &child : *std::any_cast<std::vector<object_t>>(&o->value))
+                pending.push(&child);
+        }
+        else if (o->type == object_type::OPERAND) {
+            auto prec = std::any_cast<constant>(&o->value)->exact_precision();
+            if (prec != MPFR_PREC_MAX)
+                max_count_ = std::min(max_count_, supported_digits(prec));
+        }
+    }
+}
+
+std::tuple<const std::wstring&, status_type, op_ptr> digit_expansion::digits(int count) {
+    count = std::clamp(count, 1, max_count_);
+    if (count == count_)
+        return { text_, status_type::OK, nullptr };
+
+    auto needed = required_precision(count);
+    if (needed > prec_) {
+        // grow geometrically so that scrolling through the digits
+        // re-evaluates only a logarithmic number of times
+        auto prec = std::max(needed, 2 * prec_);
+        auto [value, st, op] = eval(expr_, prec);
+        if (st != status_type::OK) {
+            count_ = -1;
+            text_.clear();
+            return { text_, st, op };
+        }
+
+        value_ = std::move(value);
+        prec_ = prec;
+    }
+
+    convert_to_wstring(value_, count, text_);
+    count_ = count;
+    return { text_, status_type::OK, nullptr };
+}
+
+int digit_expansion::precision() const noexcept {
+    return prec_;
+}
+
+int digit_expansion::required_precision(int count) noexcept {
+    return static_cast<int>(std::ceil(count * std::log2(10.0))) + kGuardBits;
+}
+
+int digit_expansion::supported_digits(mpfr_prec_t prec) noexcept {
+    auto count = std::floor((prec - kGuardBits) / std::log2(10.0));
+    return std::max(static_cast<int>(count), 1);
+}
+
+} // namespace calculator
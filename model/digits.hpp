@@ -0,0 +1,45 @@
+#pragma once
+
+#include <tuple>
+#include <limits>
+#include <string>
+#include "object.hpp"
+#include "op.hpp"
+#include "status.hpp"
+#include "number.hpp"
+
+namespace calculator {
+
+// Decimal digits of an expression's value produced on demand. The value is
+// kept at the precision it was evaluated with; asking for more digits than
+// those bits can back re-evaluates the expression at a higher precision,
+// with literals and named constants rounded again at it. Operands known only
+// to some bits, like earlier results, cap the digits at what they back.
+class digit_expansion {
+public:
+    static constexpr int kGuardBits = 64;
+
+public:
+    digit_expansion() = default;
+    explicit digit_expansion(object_t expr);
+
+    // The value with count significant digits, laid out like
+    // convert_to_wstring, or with as many as the operands back if fewer. On
+    // failure the text is empty.
+    std::tuple<const std::wstring&, status_type, op_ptr> digits(int count);
+
+    int precision() const noexcept;
+
+    static int required_precision(int count) noexcept;
+    static int supported_digits(mpfr_prec_t prec) noexcept;
+
+private:
+    object_t expr_;
+    number_t value_;
+    int prec_{ 0 };
+    int max_count_{ std::numeric_limits<int>::max() };
+    int count_{ -1 };
+    std::wstring text_;
+};
+
+} // namespace calculator
@@ -1,136 +1,153 @@
+#include <cmath>
+#include <limits>
 #include <vector>
 #include <stack>
+#include <optional>
+#include <unordered_map>
 #include "eval.hpp"
 
 namespace calculator {
 
-struct eval_context {
-    std::stack<number_t> nums;
-    std::stack<op_ptr> ops;
-    object_t expr;
-    int i;
+namespace {
 
-    eval_context() = default;
-    eval_context(const object_t &obj) : expr{obj}, i{-1}
-    { }
-};
+using cost_map = std::unordered_map<const object_t*, double>;
+
+// Below this estimate a subtree is cheaper to evaluate inline than to schedule.
+constexpr double k_split_threshold = 512;
+constexpr int k_max_split_depth = 64;
 
-std::vector<number_t> extract_args(std::stack<number_t> &src, op_category op) {
-    std::vector<number_t> res;
+const std::vector<object_t>& children(const object_t &expr) {
+    return *std::any_cast<std::vector<object_t>>(&expr.value);
+}
 
-    switch (op)
+// Rough cost of one operator application in units of a 64-bit addition:
+// additions are linear in the limb count, the rest follow Karatsuba-like
+// multiplication and transcendental functions add a logarithmic factor.
+double op_cost(const operation &op, int prec) {
+    auto limbs = std::max(1.0, prec / 64.0);
+    auto mult = std::pow(limbs, 1.6);
+
+    switch (op.type())
     {
-    case op_category::BINARY: 
-        {
-            if (src.size() < 2)
-                break;
-            auto sec = src.top(); src.pop();
-            res.push_back(src.top());
-            src.pop();
-            res.push_back(sec);
-        }
-        break;
-    case op_category::UNARY:
-        if (src.empty())
-            break;
-        res.push_back(src.top());
-        src.pop();
-        break;
+    case symbol_type::ADD:
+    case symbol_type::MINUS:
+        return limbs;
+    case symbol_type::MULT:
+    case symbol_type::MOD:
+        return mult;
+    case symbol_type::DIV:
+    case symbol_type::SQRT:
+        return 2 * mult;
+    case symbol_type::FACT:
+        return 64 * mult;
     default:
-        break;
+        return 8 * mult * std::log2(prec + 2);
     }
-
-    return res;
 }
 
-std::tuple<bool, status_type, op_ptr> eval_expression(eval_context &ec, number_t &result, int prec) {
-    auto &nums = ec.nums;
-    auto &ops = ec.ops;
-    auto &expr = ec.expr;
-    auto &childs = *std::any_cast<std::vector<object_t>>(&expr.value);
-
-    op_ptr curop;
-    for(auto i = ec.i + 1; i < childs.size(); ++i) {
-        auto &o = childs[i];
-        switch (o.type)
-        {
-        case object_type::EXPR:
-            ec.i = i;
-            return { false, status_type::OK, nullptr };
-        case object_type::OPERAND: 
-            {
-                auto [num, st] = std::any_cast<constant>(o.value).exec({});
-                num.set_prec(prec);
-                nums.push(std::move(num));     
-            }
-            break;
-        case object_type::OPERATOR: 
+cost_map estimate_costs(const object_t &expression, int prec) {
+    cost_map costs;
+    std::stack<std::pair<const object_t*, bool>> pending;
+
+    pending.emplace(&expression, false);
+    while(!pending.empty()) {
+        auto [expr, visited] = pending.top(); 
+        pending.pop();
+
+        if (!visited) {
+            pending.emplace(expr, true);
+            for (auto &o : children(*expr))
+                if (o.type == object_type::EXPR)
+                    pending.emplace(&o, false);
+            continue;
+        }
+
+        double total{ 0 };
+        for (auto &o : children(*expr)) {
+            switch (o.type)
             {
-                auto op = std::any_cast<op_ptr>(o.value);
-                while(!ops.empty() && ops.top()->priority() >= op->priority()) {
-                    curop = ops.top(); ops.pop();
-                    auto [res, status] = curop->exec(extract_args(nums, curop->category()));
-                    if (status != status_type::OK)
-                        return { false, status, curop };
-                    nums.push(res);
-                }
-                ops.push(op); 
+            case object_type::EXPR:
+                total += costs.at(&o);
+                break;
+            case object_type::OPERATOR:
+                total += op_cost(*std::any_cast<op_ptr>(o.value), prec);
+                break;
+            default:
+                total += 1;
+                break;
             }
-            break;
-        default:
-            break;
         }
+        costs.emplace(expr, total);
     }
 
-    while(!ops.empty()) {
-        auto curop = ops.top(); ops.pop();
-        auto [res, status] = curop->exec(extract_args(nums, curop->category()));
-        if (status != status_type::OK)
-            return { false, status, curop };
-        nums.push(res);
-    }
+    return costs;
+}
 
-    if (nums.empty())
-        return { false, status_type::INVALID_EVAL, nullptr };
+struct split_context {
+    thread_pool &pool;
+    const cost_map &costs;
+    int prec;
+    number_defaults defaults;
+};
 
-    result = nums.top();
+// Evaluates the costly brackets of the expression on the pool, then runs
+// the expression's own program with their results in place. The program
+// takes the results in the order it would have evaluated the brackets, so
+// a failure is reported where the sequential run reports it.
+std::tuple<number_t, status_type, op_ptr> eval_split(
+    const object_t &expression, 
+    const split_context &sc, 
+    int depth
+) {
+    program::ready_map ids;
+    for (auto &o : children(expression)) {
+        if (o.type == object_type::EXPR && sc.costs.at(&o) >= k_split_threshold) {
+            auto id = ids.size();
+            ids.emplace(&o, id);
+        }
+    }
+
+    std::vector<program::result_type> ready(ids.size());
+    {
+        task_group group{ sc.pool };
+        for (auto [o, id] : ids) {
+            group.run([&, o, id]() {
+                sc.defaults.apply();
+                ready[id] = (depth + 1 < k_max_split_depth)
+                    ? eval_split(*o, sc, depth + 1)
+                    : eval(*o, sc.prec);
+            });
+        }
+        group.wait();
+    }
 
-    return { true, status_type::OK, curop };
+    return program{ expression, sc.prec, ids }.run(ready);
 }
 
-std::tuple<number_t, status_type, op_ptr> eval(const object_t &expression, int prec) {
-    std::stack<eval_context> conts;
-    bool eval_ready{false};
-    number_t result{0};
+} // namespace
 
-    conts.emplace(expression);
-    while(!conts.empty()) {
-        auto &cont = conts.top();
+std::tuple<number_t, status_type, op_ptr> eval(const object_t &expression, int prec) {
+    return program{ expression, prec }.run();
+}
 
-        if (eval_ready) {
-            cont.nums.push(result);
-            eval_ready = false;
-        }
+std::tuple<number_t, status_type, op_ptr> eval(const object_t &expression, thread_pool &pool, int prec) {
+    auto costs = estimate_costs(expression, prec);
+    if (costs.at(&expression) < k_split_threshold)
+        return eval(expression, prec);
 
-        auto [fin, status, op] = eval_expression(cont, result, prec);
-        if (status != status_type::OK)
-            return { result, status, op };
+    split_context sc{
+        pool,
+        costs,
+        prec,
+        number_defaults{}
+    };
 
-        if (fin) {
-            eval_ready = true;
-            conts.pop();
-        }
-        else {
-            auto &childs = *std::any_cast<std::vector<object_t>>(&cont.expr.value);
-            conts.emplace(childs[cont.i]);
-        }
-    }
+    return eval_split(expression, sc, 0);
+}
 
-    return { 
-        result, 
-        status_type::OK, 
-        nullptr
-    };
+std::tuple<number_t, status_type, op_ptr> eval(const object_t &expression, eval_cache &cache, int prec, const cancel_token *cancel) {
+    // the whole expression is its first bracket, looked up before any other
+    return program{ expression, prec }.run(cache, cancel);
 }
 
 } // namespace calculator
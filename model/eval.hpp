@@ -5,12 +5,38 @@
 #include "object.hpp"
 #include "op.hpp"
 #include "status.hpp"
+#include "thread_pool.hpp"
+#include "eval_cache.hpp"
+#include "program.hpp"
 
 namespace calculator {
 
+// Lowers the expression to a program and runs it. On failure the returned
+// number is unspecified.
 std::tuple<number_t, status_type, op_ptr> eval(
 	const object_t& obj, 
 	int prec = 1 << 6
 );
 
+// Evaluates independent bracketed subexpressions on the pool's workers when
+// their estimated cost is worth the scheduling. Successful results are
+// bit-identical to the sequential overload; on failure the status and the
+// failed operation match it, the returned number is unspecified.
+std::tuple<number_t, status_type, op_ptr> eval(
+	const object_t& obj, 
+	thread_pool& pool,
+	int prec = 1 << 6
+);
+
+// Reuses the cached results of subexpressions whose structural hash is
+// already known and stores the ones it computes. Results, statuses and
+// failed operations are the same as the sequential overload's. Setting
+// cancel stops it before its next step with CANCELLED.
+std::tuple<number_t, status_type, op_ptr> eval(
+	const object_t& obj, 
+	eval_cache& cache,
+	int prec = 1 << 6,
+	const cancel_token* cancel = nullptr
+);
+
 } // namespace calculator
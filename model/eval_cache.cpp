@@ -0,0 +1,79 @@
+#include <algorithm>
+#include "eval_cache.hpp"
+
+namespace calculator {
+
+eval_cache::eval_cache(size_t capacity) : capacity_{ capacity }
+{ }
+
+std::optional<eval_cache::value_type> eval_cache::find(size_t hash, int prec, std::span<const size_t> shape) {
+    if (!hash)
+        return std::nullopt;
+
+    auto it = index_.find(make_key(hash, prec));
+    if (it == index_.end() || !std::ranges::equal(it->second->shape, shape)) {
+        ++misses_;
+        return std::nullopt;
+    }
+
+    ++hits_;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return it->second->value;
+}
+
+// A subexpression colliding with a cached one replaces it.
+void eval_cache::insert(size_t hash, int prec, std::span<const size_t> shape, const value_type &value) {
+    auto key = make_key(hash, prec);
+    if (!hash || !capacity_)
+        return;
+
+    if (auto it = index_.find(key); it != index_.end()) {
+        if (std::ranges::equal(it->second->shape, shape))
+            return;
+        entries_.erase(it->second);
+        index_.erase(it);
+    }
+
+    entries_.push_front({ key, { shape.begin(), shape.end() }, value });
+    index_.emplace(key, entries_.begin());
+    shrink();
+}
+
+eval_cache::stats_t eval_cache::stats() const noexcept {
+    return { hits_, misses_, entries_.size(), capacity_ };
+}
+
+void eval_cache::clear() {
+    index_.clear();
+    entries_.clear();
+    hits_ = misses_ = 0;
+}
+
+void eval_cache::set_capacity(size_t capacity) {
+    capacity_ = capacity;
+    shrink();
+}
+
+size_t eval_cache::key_hash::operator()(const key_t &key) const noexcept {
+    auto res = hash_combine(key.hash, static_cast<size_t>(key.prec));
+    res = hash_combine(res, static_cast<size_t>(key.default_prec));
+    return hash_combine(res, static_cast<size_t>(key.rnd));
+}
+
+eval_cache::key_t eval_cache::make_key(size_t hash, int prec) {
+    return { 
+        hash, 
+        prec, 
+        mpfr::mpreal::get_default_prec(), 
+        mpfr::mpreal::get_default_rnd() 
+    };
+}
+
+void eval_cache::shrink() {
+    while (entries_.size() > capacity_) {
+        index_.erase(entries_.back().key);
+        entries_.pop_back();
+    }
+}
+
+} // namespace calculator
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <list>
+#include <span>
+#include <tuple>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include "number.hpp"
+#include "status.hpp"
+#include "op.hpp"
+
+namespace calculator {
+
+// Bounded LRU of subexpression results keyed by the structural hash the
+// parser assigns to every EXPR, the evaluation precision and the MPFR
+// defaults. Unchanged brackets of an edited expression keep their hashes,
+// so re-evaluating it only recomputes the subexpressions on the edited path.
+// Every entry also keeps the canonical words of its subexpression, and a
+// lookup whose words differ is a miss, so colliding hashes never share a
+// result.
+class eval_cache {
+public:
+    using value_type = std::tuple<number_t, status_type, op_ptr>;
+
+    struct stats_t {
+        size_t hits;
+        size_t misses;
+        size_t size;
+        size_t capacity;
+    };
+
+    static constexpr size_t kDefaultCapacity = 512;
+
+public:
+    explicit eval_cache(size_t capacity = kDefaultCapacity);
+
+    std::optional<value_type> find(size_t hash, int prec, std::span<const size_t> shape);
+    void insert(size_t hash, int prec, std::span<const size_t> shape, const value_type &value);
+
+    stats_t stats() const noexcept;
+    void clear();
+    void set_capacity(size_t capacity);
+
+private:
+    struct key_t {
+        size_t hash;
+        int prec;
+        mpfr_prec_t default_prec;
+        mp_rnd_t rnd;
+
+        bool operator==(const key_t&) const = default;
+    };
+
+    struct key_hash {
+        size_t operator()(const key_t &key) const noexcept;
+    };
+
+    struct entry_t {
+        key_t key;
+        std::vector<size_t> shape;
+        value_type value;
+    };
+
+    static key_t make_key(size_t hash, int prec);
+    void shrink();
+
+private:
+    std::list<entry_t> entries_;
+    std::unordered_map<key_t, decltype(entries_)::iterator, key_hash> index_;
+    size_t capacity_;
+    size_t hits_{ 0 };
+    size_t misses_{ 0 };
+};
+
+} // namespace calculator
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <algorithm>
 #include "lexer.hpp"
 
 namespace calculator {
@@ -11,15 +12,17 @@ token_t ok(token_type type, std::any val = nullptr) {
     return result(type, status_type::OK, val);
 }
 
-lexer::lexer(std::wistream& istr, int prec) : 
+lexer::lexer(std::wistream& istr, int prec, std::vector<std::wstring> variables) : 
     cur_{ L' ' }, 
     precision_{ prec }, 
+    variables_{ std::move(variables) },
     stream_ { istr }
 { }
 
-lexer::lexer(const std::wstring& str, int prec) : 
+lexer::lexer(const std::wstring& str, int prec, std::vector<std::wstring> variables) : 
     cur_{ L' ' },
     precision_{ prec },
+    variables_{ std::move(variables) },
     source_{ str },
     stream_{ source_ }
 { }
@@ -37,6 +40,29 @@ int lexer::get_current_position() const {
 }
 
 token_t lexer::get_token() {
+    auto tok = read_token();
+    operand_expected_ = expects_operand(tok);
+    return tok;
+}
+
+// Operands come first, after an opening bracket and after an operator other
+// than the factorial; the rest of the tokens end one.
+bool lexer::expects_operand(const token_t &tok) {
+    switch (tok.type)
+    {
+    case token_type::LBRACKET:
+        return true;
+    case token_type::SYMBOL:
+        {
+            auto type = std::any_cast<symbol_type>(tok.value);
+            return type != symbol_type::FACT && type != symbol_type::PI && type != symbol_type::E;
+        }
+    default:
+        return false;
+    }
+}
+
+token_t lexer::read_token() {
     skip_whites();
 
     if (empty_) {
@@ -62,16 +88,98 @@ token_t lexer::get_token() {
     }
 }
 
+// filled by the first lookup, so that startup does not pay for it
+const std::unordered_map<std::wstring, symbol_type>& lexer::symbols() {
+    static const std::unordered_map<std::wstring, symbol_type> table = {
+        { L"+",      symbol_type::ADD            },
+        { L"x",      symbol_type::MULT           },
+        { L"/",      symbol_type::DIV            },
+        { L"^",      symbol_type::POW            },
+        { L"-",      symbol_type::MINUS          },
+        { L"!",      symbol_type::FACT           },
+        { L"%",      symbol_type::MOD            },
+        { L"cos",    symbol_type::COS            },
+        { L"sin",    symbol_type::SIN            },
+        { L"tan",    symbol_type::TAN            },
+        { L"asin",   symbol_type::ASIN           },
+        { L"acos",   symbol_type::ACOS           },
+        { L"atan",   symbol_type::ATAN           },
+        { L"lg",     symbol_type::LG             },
+        { L"ln",     symbol_type::LN             },
+
+        { L"sqrt",   symbol_type::SQRT           },
+        { L"\u221A", symbol_type::SQRT           },
+
+        { L"PI",      symbol_type::PI            },
+        { L"\u03C0",  symbol_type::PI            },
+
+        { L"E",      symbol_type::E              },
+        { L"\u03B5", symbol_type::E              },
+    };
+    return table;
+}
+
 std::vector<std::wstring> lexer::get_symbols() {
     std::vector<std::wstring> res;
-    res.reserve(symbols_.size());
+    res.reserve(symbols().size());
     std::transform(
-        symbols_.begin(), symbols_.end(), 
+        symbols().begin(), symbols().end(), 
         std::back_inserter(res), [](auto&& val) { return val.first; }
     );
     return res;
 }
 
+bool lexer::is_infix(symbol_type type) noexcept {
+    switch (type)
+    {
+    case symbol_type::ADD:
+    case symbol_type::MULT:
+    case symbol_type::DIV:
+    case symbol_type::POW:
+    case symbol_type::MOD:
+        return true;
+    default:
+        return false;
+    }
+}
+
+bool lexer::is_valid_variable(const std::wstring &name) {
+    static const std::wstring forbidden = L"() \n\t.";
+    if (name.empty())
+        return false;
+
+    auto bad_char = std::any_of(name.begin(), name.end(), [](wchar_t ch) {
+        return iswdigit(ch) || forbidden.find(ch) != std::wstring::npos;
+    });
+    if (bad_char)
+        return false;
+
+    // symbols are read up to the first match, so neither may prefix the
+    // other; a name equal to an infix operator is read where an operand is
+    // expected, which the operator never is
+    return std::none_of(symbols().begin(), symbols().end(), [&name](auto &&val) {
+        auto &[symbol, type] = val;
+        if (name == symbol && is_infix(type))
+            return false;
+        return name.starts_with(symbol) || symbol.starts_with(name);
+    });
+}
+
+bool lexer::are_valid_variables(const std::vector<std::wstring> &names) {
+    if (!std::all_of(names.begin(), names.end(), is_valid_variable))
+        return false;
+
+    // the same holds between variables, a name read first would hide the other
+    for (auto it = names.begin(); it != names.end(); ++it) {
+        auto clash = std::any_of(std::next(it), names.end(), [&it](auto &&other) {
+            return it->starts_with(other) || other.starts_with(*it);
+        });
+        if (clash)
+            return false;
+    }
+    return true;
+}
+
 void lexer::get_char() {
     if (empty_)
         return;
@@ -144,10 +252,10 @@ token_t lexer::get_number() {
         last_ = num_ostr.str();
         if (digs_count > precision_)
             return result(token_type::NUMBER, status_type::TOO_LONG_NUMBER);
-        number_t num;
-        num.set_prec(4 * precision_);
-        num = std::string{ last_.begin(), last_.end() };
-        return ok(token_type::NUMBER, num);
+        literal lit{ number_t{}, std::string{ last_.begin(), last_.end() } };
+        lit.value.set_prec(4 * precision_);
+        lit.value = lit.digits;
+        return ok(token_type::NUMBER, std::move(lit));
     }
     catch(std::invalid_argument){
         return result(token_type::NUMBER, status_type::INVALID_NUMBER);
@@ -160,14 +268,28 @@ token_t lexer::get_number() {
 token_t lexer::get_symbol() {
     std::wostringstream op_ostr;
     read_until_bound(op_ostr, [&]() {
-        return !is_digit() && symbols_.find(op_ostr.str()) == symbols_.end();
+        auto cur = op_ostr.str();
+        return !is_digit() && symbols().find(cur) == symbols().end() && !find_variable(cur);
     });
 
     last_ = op_ostr.str();
 
-    return symbols_.find(last_) != symbols_.end()
-        ? ok(token_type::SYMBOL, symbols_.at(last_))
-        : result(token_type::SYMBOL, status_type::UNKNOWN_SYMBOL, symbol_type::UNKNOWN);
+    auto symbol = symbols().find(last_);
+    auto id = find_variable(last_);
+    if (id && (symbol == symbols().end() || operand_expected_))
+        return ok(token_type::VARIABLE, *id);
+
+    if (symbol != symbols().end())
+        return ok(token_type::SYMBOL, symbol->second);
+
+    return result(token_type::SYMBOL, status_type::UNKNOWN_SYMBOL, symbol_type::UNKNOWN);
+}
+
+std::optional<size_t> lexer::find_variable(const std::wstring &name) const {
+    auto it = std::find(variables_.begin(), variables_.end(), name);
+    return (it != variables_.end())
+        ? std::optional<size_t>{ static_cast<size_t>(it - variables_.begin()) }
+        : std::nullopt;
 }
 
 } // namespace calculator
@@ -3,6 +3,8 @@
 
 #include <any>
 #include <string>
+#include <vector>
+#include <optional>
 #include <functional>
 #include <unordered_map>
 #include "status.hpp"
@@ -11,12 +13,19 @@
 
 namespace calculator {
 
+// Value of a number token: the number at the lexer's precision and the
+// digits it was read from, which can be read again at any other.
+struct literal {
+    number_t value;
+    std::string digits;
+};
+
 class lexer {
 public:
     lexer() = delete;
 
-    lexer(std::wistream &istr, int prec);
-    lexer(const std::wstring& str, int prec);
+    lexer(std::wistream &istr, int prec, std::vector<std::wstring> variables = {});
+    lexer(const std::wstring& str, int prec, std::vector<std::wstring> variables = {});
 
     bool empty() const noexcept;
     std::wstring get_last() const;
@@ -25,6 +34,10 @@ public:
     token_t get_token();
 
     static std::vector<std::wstring> get_symbols();
+    // A variable may be named as an infix operator, "x" for one; the name
+    // then means the variable wherever an operand is expected.
+    static bool is_valid_variable(const std::wstring &name);
+    static bool are_valid_variables(const std::vector<std::wstring> &names);
 
 private:
     void get_char();
@@ -36,44 +49,24 @@ private:
 
     void read_until_bound(std::wostringstream &out, const std::function<bool()> &pred);
 
+    token_t read_token();
     token_t get_number();
     token_t get_symbol();
+    std::optional<size_t> find_variable(const std::wstring &name) const;
 
-private:
-    inline static const std::unordered_map<std::wstring, symbol_type> symbols_ = {
-        { L"+",      symbol_type::ADD            },
-        { L"x",      symbol_type::MULT           },
-        { L"/",      symbol_type::DIV            },
-        { L"^",      symbol_type::POW            },
-        { L"-",      symbol_type::MINUS          },
-        { L"!",      symbol_type::FACT           },
-        { L"%",      symbol_type::MOD            },
-        { L"cos",    symbol_type::COS            },
-        { L"sin",    symbol_type::SIN            },
-        { L"tan",    symbol_type::TAN            },
-        { L"asin",   symbol_type::ASIN           },
-        { L"acos",   symbol_type::ACOS           },
-        { L"atan",   symbol_type::ATAN           },
-        { L"lg",     symbol_type::LG             },
-        { L"ln",     symbol_type::LN             },
-
-        { L"sqrt",   symbol_type::SQRT           },
-        { L"\u221A", symbol_type::SQRT           },
-
-        { L"PI",      symbol_type::PI            },
-        { L"\u03C0",  symbol_type::PI            },
-
-        { L"E",      symbol_type::E              },
-        { L"\u03B5", symbol_type::E              },
-    };
+    static const std::unordered_map<std::wstring, symbol_type>& symbols();
+    static bool is_infix(symbol_type type) noexcept;
+    static bool expects_operand(const token_t &tok);
 
 private:
     bool empty_{false}, blocked_{false};
+    bool operand_expected_{ true };
     wchar_t cur_;
     int precision_;
 
     std::wstring last_;
     int pos_{ 0 };
+    std::vector<std::wstring> variables_;
     std::wistringstream source_;
     std::wistream &stream_;
 };
@@ -1,27 +1,168 @@
 #pragma once
 
+#include <map>
+#include <tuple>
+#include <string>
+#include <vector>
 #include <sstream>
+#include <algorithm>
 #include "mpreal/mpreal.h"
 
 namespace calculator {
 
 using number_t = mpfr::mpreal;
 
-inline std::wstring convert_to_wstring(const number_t &num, int prec) {
-    auto n = num;
+// MPFR keeps its default precision and rounding mode per thread, so work moved
+// to another thread has to carry the caller's settings along.
+struct number_defaults {
+    mpfr_prec_t prec{ mpfr::mpreal::get_default_prec() };
+    mp_rnd_t rnd{ mpfr::mpreal::get_default_rnd() };
+
+    void apply() const {
+        mpfr::mpreal::set_default_prec(prec);
+        mpfr::mpreal::set_default_rnd(rnd);
+    }
+};
+
+inline size_t hash_combine(size_t seed, size_t value) noexcept {
+    return seed ^ (value + 0x9e3779b97f4a7c15ull + (seed << 6) + (seed >> 2));
+}
+
+// Hash of the exact value and precision, equal numbers of different
+// precisions hash differently.
+inline size_t hash_value(const number_t &num) noexcept {
+    auto src = num.mpfr_srcptr();
+    auto res = hash_combine(static_cast<size_t>(src->_mpfr_prec), static_cast<size_t>(src->_mpfr_sign));
+    res = hash_combine(res, static_cast<size_t>(src->_mpfr_exp));
+
+    if (!mpfr_regular_p(src))
+        return res;
+
+    auto limbs = (src->_mpfr_prec + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    for (auto i = 0; i < limbs; ++i)
+        res = hash_combine(res, static_cast<size_t>(src->_mpfr_d[i]));
+    return res;
+}
+
+// Appends the words hash_value reads, so that equal sequences mean equal
+// numbers of equal precision.
+inline void append_words(std::vector<size_t> &out, const number_t &num) {
+    auto src = num.mpfr_srcptr();
+    out.push_back(static_cast<size_t>(src->_mpfr_prec));
+    out.push_back(static_cast<size_t>(src->_mpfr_sign));
+    out.push_back(static_cast<size_t>(src->_mpfr_exp));
+
+    if (!mpfr_regular_p(src))
+        return;
+
+    auto limbs = (src->_mpfr_prec + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+    out.insert(out.end(), src->_mpfr_d, src->_mpfr_d + limbs);
+}
+
+// Exact 10^exp, at the default precision when that is enough (as
+// mpfr::pow(10, exp) would give it) and wider otherwise; computed once per
+// thread and exponent.
+inline const number_t& power_of_ten(int exp) {
+    using key_t = std::tuple<int, mpfr_prec_t, mp_rnd_t>;
+    static thread_local std::map<key_t, number_t> table;
+
+    key_t key{ exp, mpfr::mpreal::get_default_prec(), mpfr::mpreal::get_default_rnd() };
+    auto it = table.find(key);
+    if (it != table.end())
+        return it->second;
+
+    // 10^exp = 2^exp * 5^exp and 5^exp takes fewer than 2.33 * exp bits
+    auto bits = std::max<mpfr_prec_t>(std::get<1>(key), 7 * static_cast<mpfr_prec_t>(exp) / 3 + 1);
+    number_t res{ 0, bits };
+    mpfr_ui_pow_ui(res.mpfr_ptr(), 10, static_cast<unsigned long>(exp), std::get<2>(key));
+    return table.emplace(key, std::move(res)).first->second;
+}
+
+// Lays out prec significant digits the way printf's %g does: fixed notation
+// for decimal exponents in [-4, prec), scientific otherwise, trailing zeros
+// and a bare point removed.
+inline void layout_general(const char *digits, long exp, int prec, std::wstring &out) {
+    out.clear();
+    if (*digits == '-') {
+        out.push_back(L'-');
+        ++digits;
+    }
+
+    auto significant = static_cast<long>(prec);
+    while (significant > 1 && digits[significant - 1] == '0')
+        --significant;
+
+    auto x = exp - 1;
+    if (-4 <= x && x < prec) {
+        if (x < 0) {
+            out.append(L"0.");
+            out.append(static_cast<size_t>(-x - 1), L'0');
+            out.append(digits, digits + significant);
+            return;
+        }
+
+        auto whole = std::min(significant, x + 1);
+        out.append(digits, digits + whole);
+        out.append(static_cast<size_t>(x + 1 - whole), L'0');
+        if (significant > x + 1) {
+            out.push_back(L'.');
+            out.append(digits + x + 1, digits + significant);
+        }
+        return;
+    }
+
+    out.push_back(static_cast<wchar_t>(digits[0]));
+    if (significant > 1) {
+        out.push_back(L'.');
+        out.append(digits + 1, digits + significant);
+    }
+
+    auto sx = std::to_wstring(x < 0 ? -x : x);
+    out.append(x < 0 ? L"e-" : L"e+");
+    if (sx.size() < 2)
+        out.push_back(L'0');
+    out.append(sx);
+}
+
+// Rounds non-integers to prec digits after the point, then prints prec
+// significant digits with trailing zeros trimmed and without a negative zero.
+// The text is written into out, reusing its storage.
+inline void convert_to_wstring(const number_t &num, int prec, std::wstring &out) {
+    static thread_local number_t n;
+    static thread_local std::string buffer;
+
+    auto rnd = mpfr::mpreal::get_default_rnd();
+    n = num;
     if (!mpfr::isint(n)) {
-        auto mult{ mpfr::pow(10, prec) };
-        n = mpfr::round(n * mult) / mult;
-        auto nabs = mpfr::abs(n);
-        if (nabs == 0)
-            n = nabs;
+        auto &mult = power_of_ten(prec);
+        mpfr_prec_round(n.mpfr_ptr(), std::max(n.get_prec(), mult.get_prec()), rnd);
+        mpfr_mul(n.mpfr_ptr(), n.mpfr_srcptr(), mult.mpfr_srcptr(), rnd);
+        mpfr_round(n.mpfr_ptr(), n.mpfr_srcptr());
+        mpfr_div(n.mpfr_ptr(), n.mpfr_srcptr(), mult.mpfr_srcptr(), rnd);
+        if (mpfr_zero_p(n.mpfr_srcptr()))
+            mpfr_abs(n.mpfr_ptr(), n.mpfr_srcptr(), rnd);
+    }
+
+    if (prec >= 2 && mpfr_regular_p(n.mpfr_srcptr())) {
+        buffer.resize(prec + 2);
+        mpfr_exp_t exp;
+        mpfr_get_str(buffer.data(), &exp, 10, prec, n.mpfr_srcptr(), rnd);
+        layout_general(buffer.data(), exp, prec, out);
+        return;
     }
 
+    // zeros, infinities, NaN and degenerate precisions
     std::ostringstream ostr;
     ostr.precision(prec);
     ostr << n;
     auto str = ostr.str();
-    return std::wstring{ str.begin(), str.end() };
+    out.assign(str.begin(), str.end());
+}
+
+inline std::wstring convert_to_wstring(const number_t &num, int prec) {
+    std::wstring res;
+    convert_to_wstring(num, prec, res);
+    return res;
 }
 
 } // namespace calculator
@@ -1,18 +1,22 @@
 #pragma once
 
 #include <any>
+#include <cstddef>
 
 namespace calculator {
 
 enum class object_type {
     EXPR,
     OPERAND,
-    OPERATOR
+    OPERATOR,
+    VARIABLE
 };
 
 struct object_t {
     object_type type;
     std::any value;
+    // Structural hash set by the parser, zero when unknown.
+    size_t hash{ 0 };
 };
 
 } // namespace calculator
@@ -1,10 +1,13 @@
 #pragma once
 
+#include <map>
 #include <memory>
+#include <optional>
 #include <functional>
 #include <numbers>
 #include "status.hpp"
 #include "lexer.hpp"
+#include "op_cache.hpp"
 
 namespace calculator {
 
@@ -14,6 +17,9 @@ struct computable {
     virtual ~computable() = default;
 };
 
+// Operand value. Literals keep the digits they were read from and named
+// constants their symbol, so at() rounds them once at any precision; other
+// values are only widened and stay exact up to their own precision.
 class constant final : public computable {
 public:
     constant() = default;
@@ -22,12 +28,29 @@ public:
     constant(const T &arg) : value_{ arg }
     { }
 
+    constant(const literal &lit) : value_{ lit.value }, digits_{ lit.digits }
+    { }
+
+    explicit constant(symbol_type name);
+
     result_type exec(const std::vector<number_t>& args) const override final {
         return { value_, status_type::OK };
     }
 
+    number_t at(mpfr_prec_t prec) const;
+
+    // Bits the value is known to, MPFR_PREC_MAX when at() can give any.
+    mpfr_prec_t exact_precision() const noexcept {
+        return (name_ || !digits_.empty()) ? MPFR_PREC_MAX : value_.get_prec();
+    }
+
+    // Appends words equal exactly for operands at() gives equal values of.
+    void append_shape(std::vector<size_t> &out) const;
+
 private:
     const number_t value_;
+    const std::string digits_;
+    const std::optional<symbol_type> name_;
 };
 
 enum class op_category {
@@ -38,10 +61,11 @@ enum class op_category {
 class operation : public computable {
 public:
     operation() = delete;
-    operation(symbol_type type, op_category category, int priority) : 
+    operation(symbol_type type, op_category category, int priority, bool memoized = false) : 
         type_(type),
         category_(category),
-        priority_(priority)
+        priority_(priority),
+        memoized_(memoized)
     { }
 
     symbol_type type() const noexcept {
@@ -56,11 +80,17 @@ public:
         return priority_;
     }
 
+    bool memoized() const noexcept {
+        return memoized_;
+    }
+
     result_type exec(const std::vector<number_t> &args) const override final {
         if (args.size() < static_cast<size_t>(category_))
             return { 0, status_type::INVALID_EVAL };
 
-        auto [res, status] = exec_impl(args);
+        auto [res, status] = memoized_
+            ? op_cache::get_or_compute(type_, args, [&]() { return exec_impl(args); })
+            : exec_impl(args);
 
         if (status != status_type::OK)
             return { res, status };
@@ -86,6 +116,7 @@ private:
     symbol_type type_;
     op_category category_;
     int priority_;
+    bool memoized_;
 };
 
 #define DECLARE_TRIVIAL_OPERATION(name, type, category, func) \
@@ -98,6 +129,16 @@ private: \
         func \
     } \
 }; 
+#define DECLARE_MEMOIZED_OPERATION(name, type, category, func) \
+class name final : public operation { \
+public: \
+    name() = delete; \
+    name(int priority) : operation(type, category, priority, true) { } \
+private: \
+    result_type exec_impl(const std::vector<number_t>& args) const override final { \
+        func \
+    } \
+}; 
 #define RESULT(arg1, arg2) result_type (arg1, arg2)
 
 DECLARE_TRIVIAL_OPERATION(addition, symbol_type::ADD, op_category::BINARY,
@@ -117,11 +158,11 @@ DECLARE_TRIVIAL_OPERATION(division, symbol_type::DIV, op_category::BINARY,
     return RESULT(args[0] / args[1], status_type::OK);
 )
 
-DECLARE_TRIVIAL_OPERATION(pow, symbol_type::POW, op_category::BINARY,
+DECLARE_MEMOIZED_OPERATION(pow, symbol_type::POW, op_category::BINARY,
     return RESULT(mpfr::pow(args[0], args[1]), status_type::OK);
 )
 
-DECLARE_TRIVIAL_OPERATION(sqrt, symbol_type::SQRT, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(sqrt, symbol_type::SQRT, op_category::UNARY,
     return RESULT(mpfr::sqrt(args[0]), status_type::OK);
 )
 
@@ -154,56 +195,112 @@ DECLARE_TRIVIAL_OPERATION(mod, symbol_type::MOD, op_category::BINARY,
     return RESULT(mpfr::mod(args[0], args[1]), status_type::OK);
 )
 
-DECLARE_TRIVIAL_OPERATION(cos, symbol_type::COS, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(cos, symbol_type::COS, op_category::UNARY,
     return RESULT(mpfr::cos(args[0]), status_type::OK);
 )
-DECLARE_TRIVIAL_OPERATION(sin, symbol_type::SIN, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(sin, symbol_type::SIN, op_category::UNARY,
     return RESULT(mpfr::sin(args[0]), status_type::OK);
 )
-DECLARE_TRIVIAL_OPERATION(tan, symbol_type::TAN, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(tan, symbol_type::TAN, op_category::UNARY,
     return RESULT(mpfr::tan(args[0]), status_type::OK);
 )
 
-DECLARE_TRIVIAL_OPERATION(acos, symbol_type::ACOS, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(acos, symbol_type::ACOS, op_category::UNARY,
     return RESULT(mpfr::acos(args[0]), status_type::OK);
 )
-DECLARE_TRIVIAL_OPERATION(asin, symbol_type::ASIN, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(asin, symbol_type::ASIN, op_category::UNARY,
     return RESULT(mpfr::asin(args[0]), status_type::OK);
 )
-DECLARE_TRIVIAL_OPERATION(atan, symbol_type::ATAN, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(atan, symbol_type::ATAN, op_category::UNARY,
     return RESULT(mpfr::atan(args[0]), status_type::OK);
 )
 
-DECLARE_TRIVIAL_OPERATION(ln, symbol_type::LN, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(ln, symbol_type::LN, op_category::UNARY,
     return RESULT(mpfr::log(args[0]), status_type::OK);
 )
-DECLARE_TRIVIAL_OPERATION(lg, symbol_type::LG, op_category::UNARY,
+DECLARE_MEMOIZED_OPERATION(lg, symbol_type::LG, op_category::UNARY,
     return RESULT(mpfr::log10(args[0]), status_type::OK);
 )
 
 using op_ptr         = std::shared_ptr<operation>;
-inline const std::unordered_map<symbol_type, op_ptr> operations = {
-    { symbol_type::FACT,            std::make_shared<factorial>(4)          },
-    { symbol_type::POW,             std::make_shared<pow>(3)                },
-    { symbol_type::MINUS,           std::make_shared<minus>(2)              },
-    { symbol_type::SQRT,            std::make_shared<sqrt>(2)               },
-    { symbol_type::MOD,             std::make_shared<mod>(2)                },
-    { symbol_type::COS,             std::make_shared<cos>(2)                },
-    { symbol_type::SIN,             std::make_shared<sin>(2)                },
-    { symbol_type::TAN,             std::make_shared<tan>(2)                },
-    { symbol_type::ACOS,            std::make_shared<acos>(2)               },
-    { symbol_type::ASIN,            std::make_shared<asin>(2)               },
-    { symbol_type::ATAN,            std::make_shared<atan>(2)               },
-    { symbol_type::LN,              std::make_shared<ln>(2)                 },
-    { symbol_type::LG,              std::make_shared<lg>(2)                 },
-    { symbol_type::MULT,            std::make_shared<multiplication>(1)     },
-    { symbol_type::DIV,             std::make_shared<division>(1)           },
-    { symbol_type::ADD,             std::make_shared<addition>(0)           },
-};
-
-inline const std::unordered_map<symbol_type, constant> constants = {
-    { symbol_type::PI,              constant(mpfr::const_pi())      },
-    { symbol_type::E,               constant(mpfr::exp(1))          },
-};
+// The tables are built on first use rather than at startup.
+inline const std::unordered_map<symbol_type, op_ptr>& operations() {
+    static const std::unordered_map<symbol_type, op_ptr> table = {
+        { symbol_type::FACT,            std::make_shared<factorial>(4)          },
+        { symbol_type::POW,             std::make_shared<pow>(3)                },
+        { symbol_type::MINUS,           std::make_shared<minus>(2)              },
+        { symbol_type::SQRT,            std::make_shared<sqrt>(2)               },
+        { symbol_type::MOD,             std::make_shared<mod>(2)                },
+        { symbol_type::COS,             std::make_shared<cos>(2)                },
+        { symbol_type::SIN,             std::make_shared<sin>(2)                },
+        { symbol_type::TAN,             std::make_shared<tan>(2)                },
+        { symbol_type::ACOS,            std::make_shared<acos>(2)               },
+        { symbol_type::ASIN,            std::make_shared<asin>(2)               },
+        { symbol_type::ATAN,            std::make_shared<atan>(2)               },
+        { symbol_type::LN,              std::make_shared<ln>(2)                 },
+        { symbol_type::LG,              std::make_shared<lg>(2)                 },
+        { symbol_type::MULT,            std::make_shared<multiplication>(1)     },
+        { symbol_type::DIV,             std::make_shared<division>(1)           },
+        { symbol_type::ADD,             std::make_shared<addition>(0)           },
+    };
+    return table;
+}
+
+// Named constants correctly rounded to prec bits, computed once per thread
+// and precision.
+inline const number_t& named_constant(symbol_type name, mpfr_prec_t prec) {
+    static thread_local std::map<std::pair<symbol_type, mpfr_prec_t>, number_t> table;
+
+    auto [it, added] = table.try_emplace({ name, prec });
+    if (added) {
+        auto &num = it->second;
+        num.set_prec(prec);
+        if (name == symbol_type::PI)
+            mpfr_const_pi(num.mpfr_ptr(), MPFR_RNDN);
+        else
+            mpfr_exp(num.mpfr_ptr(), number_t{ 1, prec }.mpfr_srcptr(), MPFR_RNDN);
+    }
+    return it->second;
+}
+
+inline constant::constant(symbol_type name) :
+    value_{ named_constant(name, 53) },
+    name_{ name }
+{ }
+
+inline number_t constant::at(mpfr_prec_t prec) const {
+    if (name_)
+        return named_constant(*name_, prec);
+    if (!digits_.empty())
+        return number_t{ digits_, prec };
+
+    auto num = value_;
+    num.set_prec(prec);
+    return num;
+}
+
+inline void constant::append_shape(std::vector<size_t> &out) const {
+    if (name_) {
+        out.push_back(0);
+        out.push_back(static_cast<size_t>(*name_));
+    }
+    else if (!digits_.empty()) {
+        out.push_back(1);
+        out.push_back(digits_.size());
+        out.insert(out.end(), digits_.begin(), digits_.end());
+    }
+    else {
+        out.push_back(2);
+        append_words(out, value_);
+    }
+}
+
+inline const std::unordered_map<symbol_type, constant>& constants() {
+    static const std::unordered_map<symbol_type, constant> table = {
+        { symbol_type::PI,              constant(symbol_type::PI)               },
+        { symbol_type::E,               constant(symbol_type::E)                },
+    };
+    return table;
+}
 
 } // namespace calculator
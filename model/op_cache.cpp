@@ -0,0 +1,88 @@
+#include "op_cache.hpp"
+
+namespace calculator {
+
+op_cache::stats_t op_cache::stats() {
+    auto &st = local();
+    return { st.hits, st.misses, st.entries.size(), st.capacity };
+}
+
+void op_cache::clear() {
+    auto &st = local();
+    st.index.clear();
+    st.entries.clear();
+    st.hits = st.misses = 0;
+}
+
+void op_cache::set_capacity(size_t capacity) {
+    auto &st = local();
+    st.capacity = capacity;
+    shrink(st);
+}
+
+size_t op_cache::key_hash::operator()(const key_t &key) const noexcept {
+    size_t res{ key.size() };
+    for (auto limb : key)
+        res ^= std::hash<mp_limb_t>{}(limb) + 0x9e3779b97f4a7c15ull + (res << 6) + (res >> 2);
+    return res;
+}
+
+op_cache::key_t op_cache::make_key(symbol_type type, const std::vector<number_t> &args) {
+    key_t key;
+    key.push_back(static_cast<mp_limb_t>(type));
+    key.push_back(static_cast<mp_limb_t>(mpfr::mpreal::get_default_rnd()));
+    key.push_back(static_cast<mp_limb_t>(mpfr::mpreal::get_default_prec()));
+
+    for (auto &arg : args) {
+        auto src = arg.mpfr_srcptr();
+        key.push_back(static_cast<mp_limb_t>(src->_mpfr_prec));
+        key.push_back(static_cast<mp_limb_t>(src->_mpfr_sign));
+        key.push_back(static_cast<mp_limb_t>(src->_mpfr_exp));
+
+        // zeros, infinities and NaN are fully described by sign and exponent
+        if (!mpfr_regular_p(src))
+            continue;
+
+        auto limbs = (src->_mpfr_prec + GMP_NUMB_BITS - 1) / GMP_NUMB_BITS;
+        key.insert(key.end(), src->_mpfr_d, src->_mpfr_d + limbs);
+    }
+
+    return key;
+}
+
+std::optional<op_cache::value_type> op_cache::lookup(const key_t &key) {
+    auto &st = local();
+    auto it = st.index.find(key);
+    if (it == st.index.end()) {
+        ++st.misses;
+        return std::nullopt;
+    }
+
+    ++st.hits;
+    st.entries.splice(st.entries.begin(), st.entries, it->second);
+    return it->second->second;
+}
+
+void op_cache::insert(key_t key, const value_type &value) {
+    auto &st = local();
+    if (!st.capacity || st.index.contains(key))
+        return;
+
+    st.entries.emplace_front(std::move(key), value);
+    st.index.emplace(st.entries.front().first, st.entries.begin());
+    shrink(st);
+}
+
+void op_cache::shrink(storage &st) {
+    while (st.entries.size() > st.capacity) {
+        st.index.erase(st.entries.back().first);
+        st.entries.pop_back();
+    }
+}
+
+op_cache::storage& op_cache::local() {
+    static thread_local storage st;
+    return st;
+}
+
+} // namespace calculator
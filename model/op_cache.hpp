@@ -0,0 +1,67 @@
+#pragma once
+
+#include <list>
+#include <vector>
+#include <optional>
+#include <unordered_map>
+#include "number.hpp"
+#include "status.hpp"
+#include "token.hpp"
+
+namespace calculator {
+
+// Bounded LRU of operation results keyed by the symbol, the exact bits and
+// precision of every argument, the default precision and the rounding mode.
+// Every thread keeps its own cache and counters, so lookups never lock.
+class op_cache {
+public:
+    using value_type = std::pair<number_t, status_type>;
+
+    struct stats_t {
+        size_t hits;
+        size_t misses;
+        size_t size;
+        size_t capacity;
+    };
+
+    static constexpr size_t kDefaultCapacity = 256;
+
+public:
+    template<typename Func>
+    static value_type get_or_compute(symbol_type type, const std::vector<number_t> &args, Func &&compute) {
+        auto key = make_key(type, args);
+        if (auto cached = lookup(key))
+            return std::move(*cached);
+
+        auto res = compute();
+        insert(std::move(key), res);
+        return res;
+    }
+
+    static stats_t stats();
+    static void clear();
+    static void set_capacity(size_t capacity);
+
+private:
+    using key_t = std::vector<mp_limb_t>;
+
+    struct key_hash {
+        size_t operator()(const key_t &key) const noexcept;
+    };
+
+    struct storage {
+        std::list<std::pair<key_t, value_type>> entries;
+        std::unordered_map<key_t, decltype(entries)::iterator, key_hash> index;
+        size_t capacity{ kDefaultCapacity };
+        size_t hits{ 0 };
+        size_t misses{ 0 };
+    };
+
+    static key_t make_key(symbol_type type, const std::vector<number_t> &args);
+    static std::optional<value_type> lookup(const key_t &key);
+    static void insert(key_t key, const value_type &value);
+    static void shrink(storage &st);
+    static storage& local();
+};
+
+} // namespace calculator
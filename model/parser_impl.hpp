@@ -11,7 +11,7 @@ namespace calculator {
 namespace {
 
 bool is_value(object_type ot) {
-    return ot == object_type::OPERAND || ot == object_type::EXPR;
+    return ot == object_type::OPERAND || ot == object_type::EXPR || ot == object_type::VARIABLE;
 }
 
 bool validate_operand(const std::vector<object_t>& objs, int id) {
@@ -59,7 +59,7 @@ bool validate_expression(const object_t& expr) {
 }
 
 void add_op(std::vector<object_t>& expr, symbol_type symbol) {
-    auto op = operations.at(symbol);
+    auto op = operations().at(symbol);
 
     switch (symbol)
     {
@@ -83,7 +83,7 @@ void add_op(std::vector<object_t>& expr, symbol_type symbol) {
         }
         auto type = expr.back().type;
         if (is_value(type))
-            expr.emplace_back(object_type::OPERATOR, operations.at(symbol_type::ADD));
+            expr.emplace_back(object_type::OPERATOR, operations().at(symbol_type::ADD));
     }
     [[fallthrough]];
     default:
@@ -92,6 +92,48 @@ void add_op(std::vector<object_t>& expr, symbol_type symbol) {
     }
 }
 
+size_t leaf_hash(object_type type, size_t payload) {
+    return hash_combine(static_cast<size_t>(type), payload);
+}
+
+// Operands get their hash when they are created, operators, variables and
+// expressions are hashed bottom-up once the tree is complete.
+void assign_hashes(object_t& root) {
+    std::stack<std::pair<object_t*, bool>> pending;
+
+    pending.emplace(&root, false);
+    while (!pending.empty()) {
+        auto [expr, visited] = pending.top();
+        pending.pop();
+
+        auto &childs = *std::any_cast<std::vector<object_t>>(&expr->value);
+        if (!visited) {
+            pending.emplace(expr, true);
+            for (auto &o : childs)
+                if (o.type == object_type::EXPR)
+                    pending.emplace(&o, false);
+            continue;
+        }
+
+        auto res = leaf_hash(object_type::EXPR, childs.size());
+        for (auto &o : childs) {
+            switch (o.type)
+            {
+            case object_type::OPERATOR:
+                o.hash = leaf_hash(o.type, static_cast<size_t>(std::any_cast<op_ptr>(o.value)->type()));
+                break;
+            case object_type::VARIABLE:
+                o.hash = leaf_hash(o.type, std::any_cast<size_t>(o.value));
+                break;
+            default:
+                break;
+            }
+            res = hash_combine(res, o.hash);
+        }
+        expr->hash = res;
+    }
+}
+
 } // namespace
 
 template<is_lexer_like Lexer>
@@ -129,17 +171,32 @@ std::pair<object_t, status_type> parse(Lexer&& lex) {
         case token_type::SYMBOL:
             {
                 auto st = std::any_cast<symbol_type>(cur.value);
-                if (constants.contains(st))
-                    cur_objs.emplace_back(object_type::OPERAND, constants.at(st));
+                if (constants().contains(st)) {
+                    auto &cnst = constants().at(st);
+                    cur_objs.emplace_back(
+                        object_type::OPERAND, 
+                        cnst, 
+                        leaf_hash(object_type::OPERAND, hash_value(cnst.exec({}).first))
+                    );
+                }
                 else
                     add_op(cur_objs, st);
             }
             break;
         case token_type::NUMBER:
-            cur_objs.emplace_back(
-                object_type::OPERAND,
-                constant(std::any_cast<number_t>(cur.value))
-            );
+            {
+                // result values come without the digits of a literal
+                auto lit = std::any_cast<literal>(&cur.value);
+                auto num = lit ? lit->value : std::any_cast<number_t>(cur.value);
+                cur_objs.emplace_back(
+                    object_type::OPERAND,
+                    lit ? constant(*lit) : constant(num),
+                    leaf_hash(object_type::OPERAND, hash_value(num))
+                );
+            }
+            break;
+        case token_type::VARIABLE:
+            cur_objs.emplace_back(object_type::VARIABLE, std::any_cast<size_t>(cur.value));
             break;
         case token_type::EMPTY:
             [[fallthrough]];
@@ -149,9 +206,11 @@ std::pair<object_t, status_type> parse(Lexer&& lex) {
         }
     }
 
-    return validate_expression(out) 
-        ? std::pair{ out, status_type::PARTLY_INVALID_EXPR } 
-        : std::pair{ out, status_type::INVALID_EXPR };
+    if (!validate_expression(out))
+        return { out, status_type::INVALID_EXPR };
+
+    assign_hashes(out);
+    return { out, status_type::PARTLY_INVALID_EXPR };
 }
 
 } // namespace calculator
@@ -0,0 +1,334 @@
+#include <stack>
+#include <limits>
+#include <algorithm>
+#include "program.hpp"
+
+namespace calculator {
+
+namespace {
+
+// Leading words of the parts of a canonical description.
+enum class shape_tag : size_t {
+    EXPR = 1,
+    OPERAND,
+    OPERATOR,
+    VARIABLE,
+    CLOSE
+};
+
+} // namespace
+
+program::program(const object_t &obj, int prec) : prec_{ prec } {
+    lower(obj, nullptr);
+}
+
+program::program(const object_t &obj, int prec, const ready_map &ready) : prec_{ prec } {
+    lower(obj, &ready);
+}
+
+size_t program::size() const noexcept {
+    return code_.size();
+}
+
+size_t program::max_depth() const noexcept {
+    return max_depth_;
+}
+
+int program::precision() const noexcept {
+    return prec_;
+}
+
+program::result_type program::run() const {
+    return execute(nullptr, nullptr, {});
+}
+
+program::result_type program::run(eval_cache &cache, const cancel_token *cancel) const {
+    return execute(&cache, cancel, {});
+}
+
+program::result_type program::run(std::span<const result_type> ready) const {
+    return execute(nullptr, nullptr, ready);
+}
+
+// Writes the canonical words of the tree in one pass: a bracket is its
+// child count, its children and a closing word, an operand is its exact
+// value. The words are read back in the same order, so two subexpressions
+// have equal words exactly when they have equal structure and operands.
+// Returns the span of every bracket.
+std::unordered_map<const object_t*, size_t> program::describe(const object_t &obj) {
+    std::unordered_map<const object_t*, size_t> ids;
+    std::stack<std::pair<const object_t*, size_t>> pending;
+
+    auto open = [&](const object_t &o) {
+        auto &childs = *std::any_cast<std::vector<object_t>>(&o.value);
+        ids.emplace(&o, spans_.size());
+        spans_.emplace_back(shape_.size(), 0);
+        shape_.push_back(static_cast<size_t>(shape_tag::EXPR));
+        shape_.push_back(childs.size());
+        pending.emplace(&o, 0);
+    };
+
+    open(obj);
+    while (!pending.empty()) {
+        auto &[expr, i] = pending.top();
+        auto &childs = *std::any_cast<std::vector<object_t>>(&expr->value);
+        if (i == childs.size()) {
+            shape_.push_back(static_cast<size_t>(shape_tag::CLOSE));
+            spans_[ids.at(expr)].second = shape_.size();
+            pending.pop();
+            continue;
+        }
+
+        auto &o = childs[i++];
+        switch (o.type)
+        {
+        case object_type::EXPR:
+            open(o);
+            break;
+        case object_type::OPERAND:
+            shape_.push_back(static_cast<size_t>(shape_tag::OPERAND));
+            std::any_cast<constant>(&o.value)->append_shape(shape_);
+            break;
+        case object_type::OPERATOR:
+            shape_.push_back(static_cast<size_t>(shape_tag::OPERATOR));
+            shape_.push_back(static_cast<size_t>(std::any_cast<op_ptr>(o.value)->type()));
+            break;
+        case object_type::VARIABLE:
+            shape_.push_back(static_cast<size_t>(shape_tag::VARIABLE));
+            shape_.push_back(std::any_cast<size_t>(o.value));
+            break;
+        }
+    }
+
+    return ids;
+}
+
+// Walks the tree frame by frame: operands are pushed, operators reduce by
+// priority and every bracket leaves exactly its top value. Errors that do
+// not depend on values become FAIL at the point the scan would stop. A
+// ready bracket is pushed like an operand.
+void program::lower(const object_t &obj, const ready_map *ready) {
+    static constexpr auto npos = std::numeric_limits<size_t>::max();
+
+    struct frame {
+        const std::vector<object_t> *childs;
+        size_t i;
+        std::stack<op_ptr> ops;
+        size_t depth;
+        size_t enter;
+    };
+
+    auto spans = ready
+        ? std::unordered_map<const object_t*, size_t>{}
+        : describe(obj);
+    size_t depth{ 0 }, nesting{ 0 };
+    std::stack<frame> frames;
+
+    auto open = [&](const object_t &o) {
+        auto enter{ npos };
+        if (o.hash && !ready) {
+            enter = code_.size();
+            emit(opcode::ENTER, 0, nullptr, o.hash, spans.at(&o));
+            max_nesting_ = std::max(max_nesting_, ++nesting);
+        }
+        frames.push({ std::any_cast<std::vector<object_t>>(&o.value), 0, {}, 0, enter });
+    };
+
+    auto push = [&](frame &f) {
+        ++f.depth;
+        max_depth_ = std::max(max_depth_, ++depth);
+    };
+
+    auto reduce = [&](frame &f, int priority) {
+        while(!f.ops.empty() && f.ops.top()->priority() >= priority) {
+            auto op = f.ops.top(); f.ops.pop();
+            auto args = static_cast<size_t>(op->category());
+            if (f.depth < args) {
+                emit(opcode::FAIL, static_cast<size_t>(status_type::INVALID_EVAL), op);
+                return false;
+            }
+
+            // the right operand of a binary operator is often a literal
+            // pushed just before it
+            if (args == 2 && code_.back().code == opcode::PUSH) {
+                auto &last = code_.back();
+                last.code = opcode::CALL_BINARY_LITERAL;
+                last.op = std::move(op);
+            }
+            else 
+                emit(args == 1 ? opcode::CALL_UNARY : opcode::CALL_BINARY, 0, op);
+
+            f.depth -= args - 1;
+            depth -= args - 1;
+        }
+        return true;
+    };
+
+    open(obj);
+    while(!frames.empty()) {
+        auto &f = frames.top();
+        if (f.i < f.childs->size()) {
+            auto &o = (*f.childs)[f.i++];
+            switch (o.type)
+            {
+            case object_type::EXPR:
+                if (ready && ready->contains(&o)) {
+                    emit(opcode::READY, ready->at(&o));
+                    push(f);
+                }
+                else
+                    open(o);
+                break;
+            case object_type::OPERAND:
+                {
+                    literals_.push_back(std::any_cast<constant>(&o.value)->at(prec_));
+                    emit(opcode::PUSH, literals_.size() - 1);
+                    push(f);
+                }
+                break;
+            case object_type::VARIABLE:
+                emit(opcode::FAIL, static_cast<size_t>(status_type::INVALID_EVAL));
+                return;
+            case object_type::OPERATOR:
+                {
+                    auto op = std::any_cast<op_ptr>(o.value);
+                    if (!reduce(f, op->priority()))
+                        return;
+                    f.ops.push(op);
+                }
+                break;
+            default:
+                break;
+            }
+            continue;
+        }
+
+        if (!reduce(f, std::numeric_limits<int>::min()))
+            return;
+
+        if (!f.depth) {
+            emit(opcode::FAIL, static_cast<size_t>(status_type::INVALID_EVAL));
+            return;
+        }
+
+        if (f.depth > 1) {
+            emit(opcode::KEEP_TOP, f.depth - 1);
+            depth -= f.depth - 1;
+        }
+
+        if (f.enter != npos) {
+            emit(opcode::LEAVE, 0, nullptr, code_[f.enter].hash, code_[f.enter].span);
+            code_[f.enter].arg = code_.size();
+            --nesting;
+        }
+
+        frames.pop();
+        if (!frames.empty())
+            ++frames.top().depth;
+    }
+}
+
+void program::emit(opcode code, size_t arg, op_ptr op, size_t hash, size_t span) {
+    code_.push_back({ code, arg, std::move(op), hash, span });
+}
+
+std::span<const size_t> program::shape(size_t span) const noexcept {
+    auto [begin, end] = spans_[span];
+    return std::span<const size_t>{ shape_ }.subspan(begin, end - begin);
+}
+
+program::result_type program::execute(eval_cache *cache, const cancel_token *cancel, std::span<const result_type> ready) const {
+    std::vector<number_t> regs(std::max<size_t>(max_depth_, 1), number_t{ 0, prec_ });
+    std::vector<number_t> unary(1, number_t{ 0, prec_ }), binary(2, number_t{ 0, prec_ });
+
+    // ENTERs of the brackets being evaluated, all of them fail together
+    std::vector<const instruction*> open;
+    open.reserve(max_nesting_);
+
+    auto fail = [&](status_type status, const op_ptr &op) {
+        if (cache)
+            for (auto enter : open)
+                cache->insert(enter->hash, prec_, shape(enter->span), { 0, status, op });
+        return std::tuple<number_t, status_type, op_ptr>{ 0, status, op };
+    };
+
+    size_t sp{ 0 };
+    for (size_t pc = 0; pc < code_.size(); ++pc) {
+        if (cancel && cancel->load(std::memory_order_relaxed))
+            return { 0, status_type::CANCELLED, nullptr };
+
+        auto &in = code_[pc];
+        switch (in.code)
+        {
+        case opcode::PUSH:
+            regs[sp++] = literals_[in.arg];
+            break;
+        case opcode::CALL_UNARY:
+            {
+                unary[0] = std::move(regs[sp - 1]);
+                auto [res, status] = in.op->exec(unary);
+                if (status != status_type::OK)
+                    return fail(status, in.op);
+                regs[sp - 1] = std::move(res);
+            }
+            break;
+        case opcode::CALL_BINARY:
+        case opcode::CALL_BINARY_LITERAL:
+            {
+                auto fused = in.code == opcode::CALL_BINARY_LITERAL;
+                if (fused)
+                    binary[1] = literals_[in.arg];
+                else
+                    binary[1] = std::move(regs[--sp]);
+                binary[0] = std::move(regs[sp - 1]);
+
+                auto [res, status] = in.op->exec(binary);
+                if (status != status_type::OK)
+                    return fail(status, in.op);
+                regs[sp - 1] = std::move(res);
+            }
+            break;
+        case opcode::KEEP_TOP:
+            regs[sp - 1 - in.arg] = std::move(regs[sp - 1]);
+            sp -= in.arg;
+            break;
+        case opcode::ENTER:
+            if (!cache)
+                break;
+            if (in.arg) {
+                if (auto cached = cache->find(in.hash, prec_, shape(in.span))) {
+                    auto &[num, status, op] = *cached;
+                    if (status != status_type::OK) {
+                        open.push_back(&in);
+                        return fail(status, op);
+                    }
+                    regs[sp++] = std::move(num);
+                    pc = in.arg - 1;
+                    break;
+                }
+            }
+            open.push_back(&in);
+            break;
+        case opcode::LEAVE:
+            if (!cache)
+                break;
+            cache->insert(in.hash, prec_, shape(in.span), { regs[sp - 1], status_type::OK, nullptr });
+            open.pop_back();
+            break;
+        case opcode::READY:
+            {
+                auto &[num, status, op] = ready[in.arg];
+                if (status != status_type::OK)
+                    return fail(status, op);
+                regs[sp++] = num;
+            }
+            break;
+        case opcode::FAIL:
+            return fail(static_cast<status_type>(in.arg), in.op);
+        }
+    }
+
+    return { regs[sp - 1], status_type::OK, nullptr };
+}
+
+} // namespace calculator
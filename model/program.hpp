@@ -0,0 +1,88 @@
+#pragma once
+
+#include <span>
+#include <tuple>
+#include <atomic>
+#include <vector>
+#include <unordered_map>
+#include "object.hpp"
+#include "op.hpp"
+#include "status.hpp"
+#include "number.hpp"
+#include "eval_cache.hpp"
+
+namespace calculator {
+
+// Set from another thread to stop a run. The run checks it before every
+// instruction and then fails with CANCELLED.
+using cancel_token = std::atomic<bool>;
+
+// Expression lowered to postfix bytecode over a value stack whose depth is
+// known once the program is built. Running it gives the same results,
+// statuses and failed operations as walking the tree. Every hashed bracket
+// is delimited by ENTER/LEAVE so that a run with an eval_cache can skip the
+// ones it already knows and remember the rest. The brackets are looked up
+// with their canonical words, which lie one inside another in shape_.
+class program {
+public:
+    using result_type = std::tuple<number_t, status_type, op_ptr>;
+
+    // Brackets evaluated apart, each with the index of its result in the
+    // span given to run(). A program built with them pushes a result where
+    // the bracket would be evaluated, or fails there with its status.
+    using ready_map = std::unordered_map<const object_t*, size_t>;
+
+public:
+    program() = default;
+    program(const object_t &obj, int prec);
+    // Built for one run with the ready results: no bracket is hashed.
+    program(const object_t &obj, int prec, const ready_map &ready);
+
+    size_t size() const noexcept;
+    size_t max_depth() const noexcept;
+    int precision() const noexcept;
+
+    result_type run() const;
+    // A cancelled run stores nothing for the brackets it leaves unfinished.
+    result_type run(eval_cache &cache, const cancel_token *cancel = nullptr) const;
+    result_type run(std::span<const result_type> ready) const;
+
+private:
+    enum class opcode {
+        PUSH,
+        CALL_UNARY,
+        CALL_BINARY,
+        CALL_BINARY_LITERAL,
+        KEEP_TOP,
+        ENTER,
+        LEAVE,
+        READY,
+        FAIL
+    };
+
+    struct instruction {
+        opcode code;
+        size_t arg;
+        op_ptr op;
+        size_t hash;
+        size_t span;
+    };
+
+    void lower(const object_t &obj, const ready_map *ready);
+    std::unordered_map<const object_t*, size_t> describe(const object_t &obj);
+    void emit(opcode code, size_t arg = 0, op_ptr op = nullptr, size_t hash = 0, size_t span = 0);
+    std::span<const size_t> shape(size_t span) const noexcept;
+
+    result_type execute(eval_cache *cache, const cancel_token *cancel, std::span<const result_type> ready) const;
+
+private:
+    std::vector<instruction> code_;
+    std::vector<number_t> literals_;
+    std::vector<size_t> shape_;
+    std::vector<std::pair<size_t, size_t>> spans_;
+    size_t max_depth_{ 0 };
+    size_t max_nesting_{ 0 };
+    int prec_{ 1 << 6 };
+};
+
+} // namespace calculator
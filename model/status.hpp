@@ -18,7 +18,8 @@ enum class status_type {
     // eval's errors
     INVALID_EVAL,
     NUMBER_OVERFLOW,
-    INVALID_ARGUMENT
+    INVALID_ARGUMENT,
+    CANCELLED
 };
 
 } // namespace calculator
\ No newline at end of file
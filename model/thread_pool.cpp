@@ -0,0 +1,174 @@
+#include <utility>
+#include <algorithm>
+#include "number.hpp"
+#include "thread_pool.hpp"
+
+namespace calculator {
+
+thread_pool::thread_pool(size_t threads) {
+    threads = std::max<size_t>(threads, 1);
+
+    queues_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+        queues_.push_back(std::make_unique<worker_queue>());
+
+    workers_.reserve(threads);
+    for (size_t i = 0; i < threads; ++i)
+        workers_.emplace_back([this, i]() { worker_loop(i); });
+}
+
+size_t thread_pool::size() const noexcept {
+    return workers_.size();
+}
+
+void thread_pool::submit(task_t task) {
+    auto id = current_worker();
+    auto &queue = (id != -1)
+        ? *queues_[id]
+        : *queues_[next_queue_++ % queues_.size()];
+
+    {
+        std::lock_guard lock{ queue.mutex };
+        queue.tasks.push_back(std::move(task));
+    }
+
+    {
+        std::lock_guard lock{ sleep_mutex_ };
+        ++pending_;
+    }
+    sleep_cv_.notify_one();
+}
+
+bool thread_pool::run_pending() {
+    auto id = current_worker();
+
+    task_t task;
+    auto found = (id != -1 && pop_local(id, task)) || steal(id, task);
+    if (!found)
+        return false;
+
+    --pending_;
+    task();
+    return true;
+}
+
+thread_pool::~thread_pool() {
+    {
+        std::lock_guard lock{ sleep_mutex_ };
+        stop_ = true;
+    }
+    sleep_cv_.notify_all();
+
+    for (auto &worker : workers_)
+        worker.join();
+}
+
+void thread_pool::worker_loop(size_t id) {
+    owner_ = this;
+    worker_id_ = static_cast<int>(id);
+
+    while (true) {
+        if (run_pending())
+            continue;
+
+        std::unique_lock lock{ sleep_mutex_ };
+        sleep_cv_.wait(lock, [this]() { return stop_ || pending_ > 0; });
+        if (stop_ && pending_ <= 0)
+            break;
+    }
+
+    owner_ = nullptr;
+    worker_id_ = -1;
+    mpfr_free_cache();
+}
+
+bool thread_pool::pop_local(size_t id, task_t &task) {
+    auto &queue = *queues_[id];
+    std::lock_guard lock{ queue.mutex };
+    if (queue.tasks.empty())
+        return false;
+
+    task = std::move(queue.tasks.back());
+    queue.tasks.pop_back();
+    return true;
+}
+
+bool thread_pool::steal(int thief, task_t &task) {
+    auto count = queues_.size();
+    auto start = static_cast<size_t>(thief + 1);
+
+    for (size_t i = 0; i < count; ++i) {
+        auto &queue = *queues_[(start + i) % count];
+        std::lock_guard lock{ queue.mutex };
+        if (queue.tasks.empty())
+            continue;
+
+        task = std::move(queue.tasks.front());
+        queue.tasks.pop_front();
+        return true;
+    }
+
+    return false;
+}
+
+int thread_pool::current_worker() const noexcept {
+    return (owner_ == this)
+        ? worker_id_
+        : -1;
+}
+
+task_group::task_group(thread_pool &pool) : pool_{ pool }
+{ }
+
+void task_group::run(thread_pool::task_t task) {
+    {
+        std::lock_guard lock{ mutex_ };
+        ++remaining_;
+    }
+    pool_.submit([this, task = std::move(task)]() {
+        std::exception_ptr error;
+        try {
+            task();
+        }
+        catch(...) {
+            error = std::current_exception();
+        }
+
+        // notified under the lock, so the group outlives the notification
+        std::lock_guard lock{ mutex_ };
+        if (error && !error_)
+            error_ = std::move(error);
+        --remaining_;
+        done_.notify_all();
+    });
+}
+
+void task_group::wait() {
+    join();
+
+    if (error_)
+        std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+task_group::~task_group() {
+    join();
+}
+
+// Runs queued tasks while there are any. With none left the group's other
+// tasks are running on workers, so it sleeps until one of them ends and
+// looks for work again, since the ones still running may have queued more.
+void task_group::join() {
+    while (true) {
+        if (pool_.run_pending())
+            continue;
+
+        std::unique_lock lock{ mutex_ };
+        if (!remaining_)
+            return;
+
+        auto running = remaining_;
+        done_.wait(lock, [this, running]() { return remaining_ != running; });
+    }
+}
+
+} // namespace calculator
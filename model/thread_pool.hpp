@@ -0,0 +1,80 @@
+#pragma once
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <vector>
+#include <thread>
+#include <memory>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+namespace calculator {
+
+class thread_pool {
+public:
+    using task_t = std::function<void()>;
+
+public:
+    thread_pool() = delete;
+    explicit thread_pool(size_t threads);
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    size_t size() const noexcept;
+
+    void submit(task_t task);
+    bool run_pending();
+
+    ~thread_pool();
+
+private:
+    struct worker_queue {
+        std::mutex mutex;
+        std::deque<task_t> tasks;
+    };
+
+    void worker_loop(size_t id);
+    bool pop_local(size_t id, task_t &task);
+    bool steal(int thief, task_t &task);
+    int current_worker() const noexcept;
+
+private:
+    static inline thread_local const thread_pool *owner_{ nullptr };
+    static inline thread_local int worker_id_{ -1 };
+
+    std::vector<std::unique_ptr<worker_queue>> queues_;
+    std::vector<std::thread> workers_;
+    std::atomic<size_t> next_queue_{ 0 };
+
+    std::mutex sleep_mutex_;
+    std::condition_variable sleep_cv_;
+    std::atomic<long> pending_{ 0 };
+    bool stop_{ false };
+};
+
+class task_group {
+public:
+    task_group() = delete;
+    explicit task_group(thread_pool &pool);
+    task_group(const task_group&) = delete;
+    task_group& operator=(const task_group&) = delete;
+
+    void run(thread_pool::task_t task);
+    void wait();
+
+    ~task_group();
+
+private:
+    void join();
+
+private:
+    thread_pool &pool_;
+    std::mutex mutex_;
+    std::condition_variable done_;
+    size_t remaining_{ 0 };
+    std::exception_ptr error_;
+};
+
+} // namespace calculator
@@ -10,6 +10,7 @@ enum class token_type {
     SYMBOL,
     LBRACKET,
     RBRACKET,
+    VARIABLE,
     EMPTY
 };
 
@@ -0,0 +1,401 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <iterator>
+#include <type_traits>
+#include "elements.hpp"
+#include "optimizedlist.hpp"
+
+// Place of a block in a BlockTree. Every node keeps the sizes of its
+// block in the stored and in the shown text and its bracket balance, and
+// the totals of these over its subtree, so the start of a block is the
+// length of the subtrees before it on the way up to the root.
+struct BlockNode {
+    BlockPtr block;
+    BlockNode* left{ nullptr };
+    BlockNode* right{ nullptr };
+    BlockNode* parent{ nullptr };
+    std::uint32_t priority{ 0 };
+    int size{ 0 }, shown_size{ 0 }, brackets{ 0 };
+    int length{ 0 }, shown_length{ 0 }, balance{ 0 };
+
+    template<int BlockNode::*Total>
+    static int totalOf(const BlockNode* node) noexcept {
+        return node ? node->*Total : 0;
+    }
+
+    // Own summed over the blocks before this one.
+    template<int BlockNode::*Total, int BlockNode::*Own>
+    int before() const noexcept {
+        auto pos = totalOf<Total>(left);
+        for (auto node = this; node->parent; node = node->parent) {
+            if (node == node->parent->right)
+                pos += totalOf<Total>(node->parent->left) + node->parent->*Own;
+        }
+        return pos;
+    }
+
+    int start() const noexcept {
+        return before<&BlockNode::length, &BlockNode::size>();
+    }
+
+    int shownStart() const noexcept {
+        return before<&BlockNode::shown_length, &BlockNode::shown_size>();
+    }
+
+    void hold(BlockPtr bl) {
+        block = std::move(bl);
+        block->node_ = this;
+        measure();
+        update();
+    }
+
+    void measure() {
+        size = block->size();
+        shown_size = block->shownSize();
+        brackets = (block->type() == calculator::token_type::LBRACKET)
+            - (block->type() == calculator::token_type::RBRACKET);
+    }
+
+    void update() noexcept {
+        length = totalOf<&BlockNode::length>(left) + size + totalOf<&BlockNode::length>(right);
+        shown_length = totalOf<&BlockNode::shown_length>(left) + shown_size + totalOf<&BlockNode::shown_length>(right);
+        balance = totalOf<&BlockNode::balance>(left) + brackets + totalOf<&BlockNode::balance>(right);
+    }
+
+    void updatePath() noexcept {
+        for (auto node = this; node; node = node->parent)
+            node->update();
+    }
+
+    // after the text of the block changed
+    void resized() {
+        measure();
+        updatePath();
+    }
+};
+
+// Blocks of an expression in text order, kept in a treap ordered by their
+// place in the sequence rather than by a key. Nodes hold lengths instead of
+// positions, so an edit changes the totals on one path and nothing after
+// it moves: finding the block at a position of the stored or the shown
+// text, the start of a block and the insertion or removal of one are
+// O(log n), and the bracket count is the total of the root. Nodes come from a pool as the ones of a list did, and
+// iterators stay valid until their block is erased.
+template<size_t Size>
+class BlockTree {
+private:
+    using ResourceType = NodePoolResource<sizeof(BlockNode), alignof(BlockNode), Size>;
+
+public:
+    using Stats = typename ResourceType::Stats;
+
+    template<bool Const>
+    class Iterator {
+    public:
+        using iterator_category = std::bidirectional_iterator_tag;
+        using value_type        = BlockPtr;
+        using difference_type   = std::ptrdiff_t;
+        using reference         = std::conditional_t<Const, const BlockPtr&, BlockPtr&>;
+        using pointer           = std::conditional_t<Const, const BlockPtr*, BlockPtr*>;
+
+        Iterator() = default;
+        Iterator(BlockNode* node, BlockNode* const* root) noexcept : node_{ node }, root_{ root }
+        { }
+
+        template<bool C = Const, typename = std::enable_if_t<C>>
+        Iterator(const Iterator<false>& it) noexcept : node_{ it.node_ }, root_{ it.root_ }
+        { }
+
+        reference operator*() const noexcept {
+            return node_->block;
+        }
+
+        pointer operator->() const noexcept {
+            return &node_->block;
+        }
+
+        Iterator& operator++() noexcept {
+            node_ = next(node_);
+            return *this;
+        }
+
+        Iterator operator++(int) noexcept {
+            auto res = *this;
+            ++*this;
+            return res;
+        }
+
+        // end() steps back to the last block
+        Iterator& operator--() noexcept {
+            node_ = node_ ? prev(node_) : rightmost(*root_);
+            return *this;
+        }
+
+        Iterator operator--(int) noexcept {
+            auto res = *this;
+            --*this;
+            return res;
+        }
+
+        friend bool operator==(const Iterator& lhs, const Iterator& rhs) noexcept {
+            return lhs.node_ == rhs.node_;
+        }
+
+        friend bool operator!=(const Iterator& lhs, const Iterator& rhs) noexcept {
+            return lhs.node_ != rhs.node_;
+        }
+
+    private:
+        friend class BlockTree;
+        friend class Iterator<!Const>;
+
+        BlockNode* node_{ nullptr };
+        BlockNode* const* root_{ nullptr };
+    };
+
+    using iterator       = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+public:
+    BlockTree() = default;
+    BlockTree(const BlockTree&) = delete;
+    BlockTree& operator=(const BlockTree&) = delete;
+
+    // The blocks move over to the nodes of this pool.
+    BlockTree& operator=(BlockTree&& rhs) {
+        if (this == &rhs)
+            return *this;
+
+        clear();
+        for (auto& bl : rhs)
+            push_back(std::move(bl));
+        rhs.clear();
+        return *this;
+    }
+
+    ~BlockTree() {
+        clear();
+    }
+
+    iterator begin() noexcept {
+        return { leftmost(root_), &root_ };
+    }
+
+    iterator end() noexcept {
+        return { nullptr, &root_ };
+    }
+
+    const_iterator begin() const noexcept {
+        return { leftmost(root_), &root_ };
+    }
+
+    const_iterator end() const noexcept {
+        return { nullptr, &root_ };
+    }
+
+    bool empty() const noexcept {
+        return !root_;
+    }
+
+    int length() const noexcept {
+        return BlockNode::totalOf<&BlockNode::length>(root_);
+    }
+
+    int shownLength() const noexcept {
+        return BlockNode::totalOf<&BlockNode::shown_length>(root_);
+    }
+
+    int balance() const noexcept {
+        return BlockNode::totalOf<&BlockNode::balance>(root_);
+    }
+
+    // block holding the position, end() past the text
+    iterator locate(int pos) noexcept {
+        return { descend<&BlockNode::length, &BlockNode::size>(root_, pos), &root_ };
+    }
+
+    const_iterator locate(int pos) const noexcept {
+        return { descend<&BlockNode::length, &BlockNode::size>(root_, pos), &root_ };
+    }
+
+    // block holding the position of the shown text, end() past it
+    const_iterator locateShown(int pos) const noexcept {
+        return { descend<&BlockNode::shown_length, &BlockNode::shown_size>(root_, pos), &root_ };
+    }
+
+    // start of the block in the shown text
+    int shownStart(const_iterator it) const noexcept {
+        return it.node_->shownStart();
+    }
+
+    // Inserts the block before pos as a leaf and rotates it up to the place
+    // its priority asks for.
+    iterator insert(iterator pos, BlockPtr block) {
+        auto node = ::new (resource_.allocate(sizeof(BlockNode), alignof(BlockNode))) BlockNode{};
+        node->priority = random();
+        node->hold(std::move(block));
+
+        if (!root_)
+            root_ = node;
+        else if (!pos.node_)
+            link(rightmost(root_), node, false);
+        else if (!pos.node_->left)
+            link(pos.node_, node, true);
+        else
+            link(rightmost(pos.node_->left), node, false);
+
+        while (node->parent && node->parent->priority < node->priority)
+            rotateUp(node);
+        return { node, &root_ };
+    }
+
+    void push_back(BlockPtr block) {
+        insert(end(), std::move(block));
+    }
+
+    // Rotates the node down to a leaf and cuts it off; returns the next one.
+    iterator erase(iterator it) {
+        auto node = it.node_;
+        auto next_node = next(node);
+
+        while (node->left || node->right) {
+            auto child = (!node->right || (node->left && node->left->priority > node->right->priority))
+                ? node->left
+                : node->right;
+            rotateUp(child);
+        }
+
+        auto parent = node->parent;
+        if (!parent)
+            root_ = nullptr;
+        else {
+            (parent->left == node ? parent->left : parent->right) = nullptr;
+            parent->updatePath();
+        }
+        destroy(node);
+
+        return { next_node, &root_ };
+    }
+
+    void clear() noexcept {
+        destroyAll(root_);
+        root_ = nullptr;
+    }
+
+    Stats stats() const noexcept {
+        return resource_.stats();
+    }
+
+    void compact() {
+        resource_.compact();
+    }
+
+private:
+    template<int BlockNode::*Total, int BlockNode::*Own>
+    static BlockNode* descend(BlockNode* node, int pos) noexcept {
+        while (node) {
+            auto left = BlockNode::totalOf<Total>(node->left);
+            if (pos < left) {
+                node = node->left;
+                continue;
+            }
+            pos -= left;
+            if (pos < node->*Own)
+                break;
+            pos -= node->*Own;
+            node = node->right;
+        }
+        return node;
+    }
+
+    static BlockNode* leftmost(BlockNode* node) noexcept {
+        while (node && node->left)
+            node = node->left;
+        return node;
+    }
+
+    static BlockNode* rightmost(BlockNode* node) noexcept {
+        while (node && node->right)
+            node = node->right;
+        return node;
+    }
+
+    static BlockNode* next(BlockNode* node) noexcept {
+        if (node->right)
+            return leftmost(node->right);
+        while (node->parent && node == node->parent->right)
+            node = node->parent;
+        return node->parent;
+    }
+
+    static BlockNode* prev(BlockNode* node) noexcept {
+        if (node->left)
+            return rightmost(node->left);
+        while (node->parent && node == node->parent->left)
+            node = node->parent;
+        return node->parent;
+    }
+
+    static void link(BlockNode* parent, BlockNode* child, bool left) noexcept {
+        (left ? parent->left : parent->right) = child;
+        child->parent = parent;
+        parent->updatePath();
+    }
+
+    // The subtree keeps its totals, only the two nodes swap theirs.
+    void rotateUp(BlockNode* node) noexcept {
+        auto parent = node->parent;
+        auto grand = parent->parent;
+
+        if (node == parent->left) {
+            parent->left = node->right;
+            if (node->right)
+                node->right->parent = parent;
+            node->right = parent;
+        }
+        else {
+            parent->right = node->left;
+            if (node->left)
+                node->left->parent = parent;
+            node->left = parent;
+        }
+
+        parent->parent = node;
+        node->parent = grand;
+        if (!grand)
+            root_ = node;
+        else
+            (grand->left == parent ? grand->left : grand->right) = node;
+
+        parent->update();
+        node->update();
+    }
+
+    void destroy(BlockNode* node) noexcept {
+        node->~BlockNode();
+        resource_.deallocate(node, sizeof(BlockNode), alignof(BlockNode));
+    }
+
+    void destroyAll(BlockNode* node) noexcept {
+        if (!node)
+            return;
+        destroyAll(node->left);
+        destroyAll(node->right);
+        destroy(node);
+    }
+
+    // xorshift, enough to keep the expected depth logarithmic
+    std::uint32_t random() noexcept {
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 17;
+        seed_ ^= seed_ << 5;
+        return seed_;
+    }
+
+private:
+    ResourceType resource_;
+    BlockNode* root_{ nullptr };
+    std::uint32_t seed_{ 2463534242u };
+};
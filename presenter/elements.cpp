@@ -1,65 +1,50 @@
 #include <tuple>
 #include "elements.hpp"
+#include "blocktree.hpp"
 
-int DelimetersContainer::getDelimetersSizeByPos(int pos) const {
-    int res{ 0 };
-    for (auto& dl : delimeters_) {
-        if (dl.pos >= pos)
-            break;
-        res += std::min(pos - dl.pos, dl.size);
-    }
-    return res;
+int NumberGaps::integerSize(std::wstring_view number) noexcept {
+    return static_cast<int>(std::min(number.find_first_of(L".eE"), number.size()));
 }
 
-DelimetersContainer::DelimetersContainer(QString& value, const std::list<Delimeter>& delims) :
-    value_{ value },
-    delimeters_{ delims }
-{ }
-
-void DelimetersContainer::insertDelimeter(int pos, const QString& val) {
-    auto curit = find(pos);
-    if (curit == delimeters_.end())
-        pos = std::min(value_.size(), pos);
-    else if (curit->isInside(pos))
-        pos = curit->pos;
-    value_.insert(pos, val);
-    delimeters_.insert(curit, { pos, val.size() });
-    shiftDelimeters(curit, val.size());
+int NumberGaps::count(int integer_sz) noexcept {
+    return (integer_sz > 0) 
+        ? (integer_sz - 1) / kGapSize 
+        : 0;
 }
 
-std::list<DelimetersContainer::Delimeter>::iterator DelimetersContainer::removeDelimeter(std::list<Delimeter>::iterator it, int offset) {
-    offset += it->size;
-    value_.remove(it->pos, it->size);
-    auto next = delimeters_.erase(it);
-    shiftDelimeters(next, -offset);
-    return next;
-}
+int NumberGaps::toShown(int integer_sz, int pos) noexcept {
+    auto gaps = count(integer_sz);
+    if (pos >= integer_sz)
+        return pos + gaps;
 
-void DelimetersContainer::clearFromDelimeters() {
-    value_ = removeDelimeters();
-    delimeters_.clear();
+    auto head = integer_sz - gaps * kGapSize;
+    return (pos < head)
+        ? pos
+        : pos + (pos - head) / kGapSize + 1;
 }
 
-std::list<DelimetersContainer::Delimeter>::iterator DelimetersContainer::find(int pos) {
-    return std::find_if(
-        delimeters_.begin(), delimeters_.end(),
-        [pos](auto& delim) {
-            return pos < (delim.pos + delim.size);
-        }
-    );
-}
+int NumberGaps::fromShown(int integer_sz, int pos) noexcept {
+    auto gaps = count(integer_sz);
+    auto head = integer_sz - gaps * kGapSize;
+    if (pos <= head)
+        return pos;
+    if (pos >= integer_sz + gaps)
+        return pos - gaps;
 
-void DelimetersContainer::shiftDelimeters(std::list<Delimeter>::iterator begin, int offset) {
-    std::for_each(begin, delimeters_.end(), [offset](auto& delim) { delim.pos += offset;  });
+    auto group = (pos - head) / (kGapSize + 1);
+    auto rest = (pos - head) % (kGapSize + 1);
+    return head + group * kGapSize + std::max(rest - 1, 0);
 }
 
-QString DelimetersContainer::removeDelimeters() const {
-    auto cur = value_;
-    for (auto it = delimeters_.rbegin(); it != delimeters_.rend(); ++it) {
-        auto& v = *it;
-        cur.remove(v.pos, v.size);
+void NumberGaps::append(std::wstring& out, std::wstring_view number) {
+    auto integer_sz = integerSize(number);
+    auto head = integer_sz - count(integer_sz) * kGapSize;
+    out.append(number.substr(0, head));
+    for (auto pos = head; pos < integer_sz; pos += kGapSize) {
+        out.push_back(kGap);
+        out.append(number.substr(pos, kGapSize));
     }
-    return cur;
+    out.append(number.substr(integer_sz));
 }
 
 Block::Block(
@@ -67,20 +52,18 @@ Block::Block(
     calculator::token_type type,
     const QString& value,
     bool isMutable,
-    format_t formatFlags,
-    const std::list<Delimeter> &delimeters
+    format_t formatFlags
 ) :
     mutable_{ isMutable },
     type_{ type },
     start_{ start },
     size_{ value.size() },
     format_flags_{ formatFlags },
-    value_{ value },
-    DelimetersContainer(value_, delimeters)
+    value_{ value }
 { }
 
 Block::Block(const Block& bl) :
-    Block(bl.start_, bl.type_, bl.value_, mutable_, format_flags_)
+    Block(bl.begin(), bl.type_, bl.value_, bl.mutable_, bl.format_flags_)
 { }
 
 BlockPtrList Block::create(int start, const QString& str) {
@@ -104,11 +87,7 @@ BlockPtrList Block::create(int start, const QString& str) {
         switch(token.type)
         {
         case calculator::token_type::SYMBOL:
-            res.push_back(std::make_unique<Symbol>(
-                nstart,
-                std::move(value),
-                std::any_cast<calculator::symbol_type>(token.value))
-            );
+            res.push_back(std::make_unique<Symbol>(nstart, std::move(value)));
             break;
         case calculator::token_type::NUMBER:
             res.push_back(std::make_unique<Number>(nstart, std::move(value)));
@@ -151,11 +130,11 @@ BlockPtrList Block::merge(int start, BlockPtrList& blocks) {
 }
 
 int Block::begin() const noexcept {
-    return start_;
+    return node_ ? node_->start() : start_;
 }
 
 int Block::end() const noexcept {
-    return start_ + size_;
+    return begin() + size_;
 }
 
 int Block::size() const noexcept {
@@ -174,6 +153,10 @@ Block::format_t& Block::formatFlags() noexcept {
     return format_flags_;
 }
 
+const Block::format_t& Block::formatFlags() const noexcept {
+    return format_flags_;
+}
+
 void Block::shift(int size) noexcept {
     start_ += size;
 }
@@ -193,12 +176,13 @@ std::tuple<BlockPtrList, BlockPtrList, int> Block::split(int pos) {
     if (!canSplit(pos))
         return { BlockPtrList{}, BlockPtrList{}, 0};
 
-    pos -= start_;
+    auto start = begin();
+    pos -= start;
     auto sz = size_;
     auto p1 = value_.left(pos);
     auto p2 = value_.right(value_.size() - pos);
 
-    auto vb1 = Block::create(start_, p1);
+    auto vb1 = Block::create(start, p1);
     auto vb2 = Block::create(vb1.list.back()->end(), p2);
 
     auto diff = vb2.list.back()->end() - sz;
@@ -210,19 +194,6 @@ std::tuple<BlockPtrList, BlockPtrList, int> Block::split(int pos) {
     };
 }
 
-int Block::insertDelimeter(int pos, const QString &delim) {
-    DelimetersContainer::insertDelimeter(pos, delim);
-    update(value_);
-    return delim.size();
-}
-
-int Block::clearFromDelimeters() {
-    auto old = value_;
-    DelimetersContainer::clearFromDelimeters();
-    update(value_);
-    return value_.size() - old.size();
-}
-
 bool Block::isMutable() const noexcept {
     return mutable_;
 }
@@ -236,7 +207,6 @@ int Block::insert(int pos, const Block& s) {
 int Block::remove(int pos, int count) {
     if (!isMutable()) {
         auto sz = size_;
-        clearFromDelimeters();
         update("");
         return sz;
     }
@@ -254,141 +224,178 @@ bool Block::merge(const Block& s) {
     return true;
 }
 
+std::shared_ptr<const calculator::token_t> Block::token() const {
+    if (!token_)
+        token_ = std::make_shared<const calculator::token_t>(lex());
+    return token_;
+}
+
 void Block::update(const QString& s) {
     value_ = s;
     size_ = value_.size();
+    token_.reset();
+    if (node_)
+        node_->resized();
+}
+
+calculator::token_t Block::lex() const {
+    calculator::lexer lex(toString(false).toStdWString(), Settings::max_output_size);
+    return lex.get_token();
 }
 
 int Block::insertMutableImpl(int pos, const Block& s) {
-    pos -= start_;
+    pos -= begin();
     auto sstr = s.toString(false);
     auto sz = sstr.size();
-    auto delim = DelimetersContainer::find(pos);
-    if (delim != delimeters_.end()) {
-        if (delim->isInside(pos))
-            pos = delim->pos;
-        DelimetersContainer::shiftDelimeters(delim, sstr.size());
-    }
     update(value_.insert(pos, std::move(sstr)));
     return sz;
 }
 
 int Block::removeMutableImpl(int pos, int count) {
-    pos -= start_;
-    auto total{ 0 }, delim_offset{ 0 };
-    auto delim_it = DelimetersContainer::find(pos);
-    while (pos < value_.size() && total < count) {
-        if (delim_it != delimeters_.end() && delim_it->isInside(pos)) {
-            auto sz = delim_it->size;
-            total += sz;
-            pos = delim_it->pos;
-            delim_it = DelimetersContainer::removeDelimeter(delim_it, 0);
-            continue;
-        }
-        auto bound = (delim_it != delimeters_.end()) ? delim_it->pos : value_.size();
-        auto sz = std::min(bound - pos, count - total);
-        value_.remove(pos, sz);
-        DelimetersContainer::shiftDelimeters(delim_it, -sz);
-        total += sz;
-    }
-    size_ = value_.size();
+    pos -= begin();
+    auto total = std::max(std::min(count, value_.size() - pos), 0);
+    value_.remove(pos, total);
+    update(value_);
     return total;
 }
 
-QString Block::toString(bool delims) const {
-    return delims 
-        ? value_ 
-        : removeDelimeters();
+QString Block::toString(bool shown) const {
+    return value_;
+}
+
+int Block::shownSize() const {
+    return size_;
 }
 
 BlockPtr Block::clone() const {
-    return BlockPtr(new Block(start_, type_, value_, mutable_, format_flags_, delimeters_));
+    auto bl = new Block(begin(), type_, value_, mutable_, format_flags_);
+    bl->token_ = token_;
+    return BlockPtr(bl);
 }
 
 Symbol::Symbol(
     int start, 
     const QString& value, 
-    calculator::symbol_type symbolType, 
-    format_t formatFlags, 
-    const std::list<Delimeter>& delimeters) :
-    Block(start, calculator::token_type::SYMBOL, value, true, formatFlags, delimeters),
-    symbol_type_{ symbolType }
+    format_t formatFlags) :
+    Block(start, calculator::token_type::SYMBOL, value, true, formatFlags),
+    run_{ automaton().run(value.toStdWString()) }
 { }
 
 calculator::symbol_type Symbol::symbol_type() const noexcept {
-    return symbol_type_;
+    return run_.type;
 }
 
 int Symbol::refresh() {
     auto old_sz = size_;
-    auto val = transformToTree(value_, -1);
-    update(val);
-    updateType(val);
+    auto [val, run] = nearest(value_.toStdWString(), run_);
+    update(QString::fromStdWString(val));
+    run_ = run;
     return size_ - old_sz;
 }
 
+bool Symbol::isRefreshed() const noexcept {
+    return !run_.dead && automaton().completion(run_.state).empty();
+}
+
+std::pair<std::wstring, calculator::symbol_type> Symbol::refreshed(const std::wstring& value) {
+    auto [nval, run] = nearest(value, automaton().run(value));
+    return { std::move(nval), run.type };
+}
+
 BlockPtr Symbol::clone() const {
-    return BlockPtr(new Symbol(start_, value_, symbol_type_, format_flags_, delimeters_));
+    auto bl = new Symbol(*this);
+    bl->token_ = token_;
+    return BlockPtr(bl);
 }
 
+// Accepted while the text it leads to reaches further than the current
+// one, which is read on from the current run when typed at the end.
 int Symbol::insertMutableImpl(int pos, const Block& s) {
     if (s.type() != calculator::token_type::SYMBOL)
         return 0;
 
-    auto bl = Block(start_, type_, value_);
-    bl.insert(pos, s);
-
-    auto old = toString(false);
-    auto val = bl.toString(false);
-    auto upd = transformToTree(val, -1);
-
-    int res{ 0 };
-    if (upd.size() > old.size()) {
-        res = Block::insertMutableImpl(pos, s);
-        updateType(toString(false));
-    }
+    auto str = s.toString(false).toStdWString();
+    auto run = (pos == end())
+        ? automaton().feed(run_, str)
+        : automaton().run(value_.toStdWString().insert(pos - begin(), str));
+    auto reach = run.matched + (run.dead
+        ? 0 
+        : static_cast<int>(automaton().completion(run.state).size()));
+    if (reach <= size_)
+        return 0;
 
+    auto res = Block::insertMutableImpl(pos, s);
+    run_ = run;
     return res;
 }
 
 int Symbol::removeMutableImpl(int pos, int count) {
     auto res = Block::removeMutableImpl(pos, count);
-    updateType(value_);
+    run_ = automaton().run(value_.toStdWString());
     return res;
 }
 
-void Symbol::updateType(const QString& val) {
-    auto token = calculator::lexer(value_.toStdWString(), Settings::max_output_size).get_token();
-    if (token.type == calculator::token_type::SYMBOL)
-        symbol_type_ = std::any_cast<calculator::symbol_type>(token.value);
-    else
-        symbol_type_ = calculator::symbol_type::UNKNOWN;
+calculator::token_t Symbol::lex() const {
+    auto whole = !run_.dead && 
+        run_.matched == size_ && 
+        automaton().accepts(run_.state) != calculator::symbol_type::UNKNOWN;
+    return whole
+        ? calculator::token_t{ calculator::token_type::SYMBOL, calculator::status_type::OK, run_.type }
+        : Block::lex();
 }
 
-QString Symbol::transformToTree(const QString& val, int threshold) {
-    auto [nval, st] = symbols_trie_.find_nearest_far(val.toStdWString());
-    auto sz = static_cast<int>(nval.size());
-    return (sz <= threshold) 
-        ? val 
-        : QString::fromStdWString(nval);
+const SymbolAutomaton& Symbol::automaton() {
+    static const SymbolAutomaton instance = [](){
+        std::vector<std::pair<std::wstring, calculator::symbol_type>> symbols;
+        for (auto& sym : calculator::lexer::get_symbols()) {
+            auto token = calculator::lexer(sym, Settings::max_output_size).get_token();
+            symbols.push_back({ sym, std::any_cast<calculator::symbol_type>(token.value) });
+        }
+        return SymbolAutomaton(symbols.begin(), symbols.end());
+    }();
+    return instance;
+}
+
+std::pair<std::wstring, SymbolAutomaton::Run> Symbol::nearest(std::wstring value, SymbolAutomaton::Run run) {
+    if (run.dead) {
+        value.resize(run.matched);
+        run.dead = false;
+        return { std::move(value), std::move(run) };
+    }
+
+    auto tail = automaton().completion(run.state);
+    value.append(tail);
+    return { std::move(value), automaton().feed(run, tail) };
 }
 
 Number::Number(
     int start, 
     const QString &value, 
-    format_t formatFlags, 
-    const std::list<Delimeter>& delimeters) :
-    Block(start, calculator::token_type::NUMBER, value, true, formatFlags, delimeters),
-    calculated_number_{0}
+    format_t formatFlags) :
+    Block(start, calculator::token_type::NUMBER, value, true, formatFlags)
 { }
 
 Number::Number(
     int start, 
     const calculator::number_t& value, 
-    format_t formatFlags, 
-    const std::list<Delimeter>& delimeters) :
-    Block(start, calculator::token_type::NUMBER, convertNumberToString(value), false, formatFlags, delimeters),
-    calculated_number_{ value }
+    format_t formatFlags) :
+    Number(start, makeResult(value), formatFlags)
+{ }
+
+Number::Number(
+    int start,
+    ResultPtr result,
+    format_t formatFlags) :
+    Number(start, result->text, result, formatFlags)
+{ }
+
+Number::Number(
+    int start,
+    const QString &value,
+    ResultPtr result,
+    format_t formatFlags) :
+    Block(start, calculator::token_type::NUMBER, value, false, formatFlags),
+    result_{ std::move(result) }
 { }
 
 int Number::insertMutableImpl(int pos, const Block& s) {
@@ -397,22 +404,43 @@ int Number::insertMutableImpl(int pos, const Block& s) {
         : 0;
 }
 
-QString Number::convertNumberToString(const calculator::number_t &num) const {
-    return QString::fromStdWString(
-        calculator::convert_to_wstring(num, Settings::max_output_size)
-    );
+Number::ResultPtr Number::makeResult(const calculator::number_t &num) {
+    static thread_local std::wstring buffer;
+    calculator::convert_to_wstring(num, Settings::max_output_size, buffer);
+    return std::make_shared<const Result>(num, QString::fromStdWString(buffer));
 }
 
 calculator::number_t Number::get() const {
     return !isMutable()
-        ? calculated_number_
-        : calculator::number_t{ toString().toStdString() };
+        ? result_->value
+        : calculator::number_t{ value_.toStdString() };
+}
+
+QString Number::toString(bool shown) const {
+    if (!shown)
+        return value_;
+
+    std::wstring out;
+    NumberGaps::append(out, value_.toStdWString());
+    return QString::fromStdWString(out);
+}
+
+int Number::shownSize() const {
+    return size_ + NumberGaps::count(NumberGaps::integerSize(value_.toStdWString()));
 }
 
 BlockPtr Number::clone() const {
-    return isMutable()
-        ? BlockPtr(new Number(start_, value_, format_flags_, delimeters_))
-        : BlockPtr(new Number(start_, calculated_number_, format_flags_, delimeters_));
+    auto bl = isMutable()
+        ? new Number(begin(), value_, format_flags_)
+        : new Number(begin(), value_, result_, format_flags_);
+    bl->token_ = token_;
+    return BlockPtr(bl);
+}
+
+calculator::token_t Number::lex() const {
+    return !isMutable()
+        ? calculator::token_t{ calculator::token_type::NUMBER, calculator::status_type::OK, result_->value }
+        : Block::lex();
 }
 
 Space::Space(int start) : Block(start, calculator::token_type::EMPTY, " ", false)
@@ -4,47 +4,36 @@
 #include <list>
 #include <bitset>
 #include <map>
+#include <string>
+#include <string_view>
+#include <vector>
 #include <QString>
-#include "trie.hpp"
+#include "symbolautomaton.hpp"
 #include "model/lexer.hpp"
 #include "settings.hpp"
 #include "optimizedlist.hpp"
 
-class DelimetersContainer {
-public:
-    int getDelimetersSizeByPos(int pos) const;
-
-protected:
-    struct Delimeter {
-        int pos;
-        int size;
-
-        bool isInside(int p) const noexcept {
-            return pos <= p && p < pos + size;
-        }
-    };
-
-protected:
-    DelimetersContainer() = delete;
-    DelimetersContainer(QString& value, const std::list<Delimeter>& delims);
-
-    void insertDelimeter(int pos, const QString& val);
-    std::list<Delimeter>::iterator removeDelimeter(std::list<Delimeter>::iterator it, int offset);
-    void clearFromDelimeters();
-    std::list<Delimeter>::iterator find(int pos);
-    void shiftDelimeters(std::list<Delimeter>::iterator begin, int offset);
-    QString removeDelimeters() const;
-
-protected:
-    QString &value_;
-    std::list<Delimeter> delimeters_;
+// The integer part of a number is shown in groups of kGapSize digits
+// counted from its end. Gaps exist only in the shown text: blocks keep the
+// digits alone, and positions map between the two arithmetically. A
+// position right at a gap is shown after it.
+struct NumberGaps {
+    static constexpr wchar_t kGap = L' ';
+    static constexpr int     kGapSize = 3;
+
+    static int integerSize(std::wstring_view number) noexcept;
+    static int count(int integer_sz) noexcept;
+    static int toShown(int integer_sz, int pos) noexcept;
+    static int fromShown(int integer_sz, int pos) noexcept;
+    static void append(std::wstring& out, std::wstring_view number);
 };
 
 class Block;
+struct BlockNode;
 using BlockPtr = std::unique_ptr<Block>;
 using BlockPtrList = OptimizedListWrapper<BlockPtr, 8>;
 
-class Block : public DelimetersContainer {
+class Block {
 public:
     static constexpr int kMaxFormattersCount = 10;
     
@@ -58,8 +47,7 @@ public:
         calculator::token_type type, 
         const QString &value, 
         bool isMutable = true,
-        format_t formatFlags = kFullFlags,
-        const std::list<Delimeter> &delimeters = {}
+        format_t formatFlags = kFullFlags
     );
     Block(const Block& bl);
 
@@ -76,16 +64,21 @@ public:
     bool canSplit(int pos) const noexcept;
 
     format_t& formatFlags() noexcept;
+    const format_t& formatFlags() const noexcept;
+
+    // Token of the text, lexed once per change of it and shared by clones.
+    std::shared_ptr<const calculator::token_t> token() const;
+    // moves a block that is not in a BlockTree, which places its own
     void shift(int size) noexcept;
 
     int insert(int pos, const Block& s);
     int remove(int pos, int count);
     bool merge(const Block& s);
     std::tuple<BlockPtrList, BlockPtrList, int> split(int pos);
-    int insertDelimeter(int pos, const QString &delim);
-    int clearFromDelimeters();
 
-    virtual QString toString(bool delims = true) const;
+    // text as shown, or as stored when shown is false
+    virtual QString toString(bool shown = true) const;
+    virtual int shownSize() const;
     virtual BlockPtr clone() const;
     
     virtual ~Block() = default;
@@ -95,6 +88,7 @@ protected:
 
     virtual int insertMutableImpl(int pos, const Block& s);
     virtual int removeMutableImpl(int pos, int count);
+    virtual calculator::token_t lex() const;
 
 protected:
     bool mutable_;
@@ -103,6 +97,14 @@ protected:
     int size_;
     format_t format_flags_;
     QString value_;
+    mutable std::shared_ptr<const calculator::token_t> token_;
+
+private:
+    friend struct BlockNode;
+
+    // set while a BlockTree holds the block; its start is then counted
+    // there and start_ is left behind
+    BlockNode* node_{ nullptr };
 };
 
 class Symbol final : public Block {
@@ -111,31 +113,38 @@ public:
     Symbol(
         int start, 
         const QString& value, 
-        calculator::symbol_type symbol_type, 
-        format_t formatFlags = kFullFlags,
-        const std::list<Delimeter>& delimeters = {}
+        format_t formatFlags = kFullFlags
     );
 
     calculator::symbol_type symbol_type() const noexcept;
     int refresh();
+    // whether refresh() would leave the symbol as it is
+    bool isRefreshed() const noexcept;
+
+    // text and type refresh() would leave in a symbol holding the value
+    static std::pair<std::wstring, calculator::symbol_type> refreshed(const std::wstring& value);
 
     BlockPtr clone() const override final;
 
 protected:
     int insertMutableImpl(int pos, const Block& s) override final;
     int removeMutableImpl(int pos, int count) override final;
+    calculator::token_t lex() const override final;
 
 private:
-    void updateType(const QString& val);
-    QString transformToTree(const QString& val, int threshold);
+    // Completes a live run up to the next symbol and cuts a dead one back
+    // to its readable prefix.
+    static std::pair<std::wstring, SymbolAutomaton::Run> nearest(
+        std::wstring value, 
+        SymbolAutomaton::Run run
+    );
 
 private:
-    static inline const Trie<wchar_t> symbols_trie_ = [](){ 
-        auto symbols = calculator::lexer::get_symbols();
-        return Trie<wchar_t>(symbols.begin(), symbols.end());
-    }();
+    // built on the first symbol typed
+    static const SymbolAutomaton& automaton();
 
-    calculator::symbol_type symbol_type_;
+    // state after the text, kept in step with every edit of it
+    SymbolAutomaton::Run run_;
 };
 
 class Number final : public Block {
@@ -144,25 +153,45 @@ public:
     Number(
         int start, 
         const QString &value, 
-        format_t formatFlags = kFullFlags, 
-        const std::list<Delimeter>& delimeters = {}
+        format_t formatFlags = kFullFlags
     );
     Number(
         int start, 
         const calculator::number_t& value,
-        format_t formatFlags = kFullFlags,
-        const std::list<Delimeter>& delimeters = {}
+        format_t formatFlags = kFullFlags
     );
 
     calculator::number_t get() const;
+    QString toString(bool shown = true) const override final;
+    int shownSize() const override final;
     BlockPtr clone() const override final;
 
 private:
+    // Evaluated value with its rendering, shared by all clones of a result
+    struct Result {
+        calculator::number_t value;
+        QString text;
+    };
+    using ResultPtr = std::shared_ptr<const Result>;
+
+    Number(
+        int start,
+        ResultPtr result,
+        format_t formatFlags
+    );
+    Number(
+        int start,
+        const QString &value,
+        ResultPtr result,
+        format_t formatFlags
+    );
+
     int insertMutableImpl(int pos, const Block& s) override final;
-    QString convertNumberToString(const calculator::number_t& num) const;
+    calculator::token_t lex() const override final;
+    static ResultPtr makeResult(const calculator::number_t& num);
 
 private:
-    calculator::number_t calculated_number_;
+    ResultPtr result_;
 };
 
 class Space : public Block {
@@ -0,0 +1,163 @@
+#pragma once
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <string_view>
+#include <QString>
+#include "model/op.hpp"
+#include "elements.hpp"
+#include "tokentable.hpp"
+#include "formatters.hpp"
+
+// Text an expression shows after EvalFormatter, built from its token table
+// without cloning or changing any block. The formatter passes are replayed
+// in the same order over items that point into the table, with the
+// decisions of FormatRules.
+class EvalView {
+public:
+    EvalView() = delete;
+    EvalView(const EvalView&) = delete;
+    EvalView& operator=(const EvalView&) = delete;
+
+    explicit EvalView(const TokenTable &tokens) {
+        items_.reserve(tokens.count());
+        for (auto id = 0; id < tokens.count(); ++id) {
+            auto type = tokens.type(id);
+            if (type == calculator::token_type::EMPTY)
+                continue;
+            items_.push_back({ type, tokens.symbolType(id), tokens.plain(id) });
+        }
+
+        completeOperations();
+        spaceBinaryOperations();
+        bracketUnaryOperations();
+        bracketMinuses();
+    }
+
+    QString toString() const {
+        std::wstring out;
+        auto opened{ 0 };
+        for (auto& item : items_) {
+            opened += item.type == calculator::token_type::LBRACKET;
+            opened -= item.type == calculator::token_type::RBRACKET;
+            if (item.type == calculator::token_type::NUMBER)
+                NumberGaps::append(out, item.text);
+            else
+                out.append(item.text);
+        }
+        for (auto i = 0; i < opened; ++i)
+            out.append(kRightBracket);
+
+        return QString::fromStdWString(out);
+    }
+
+private:
+    struct Item {
+        calculator::token_type type;
+        calculator::symbol_type symbol;
+        std::wstring_view text;
+    };
+
+    static constexpr std::wstring_view kSpace = L" ";
+    static constexpr std::wstring_view kLeftBracket = L"(";
+    static constexpr std::wstring_view kRightBracket = L")";
+
+private:
+    static calculator::op_ptr operation(const Item& item) {
+        return FormatRules::operation(item.type, item.symbol);
+    }
+
+    static Item space() {
+        return { calculator::token_type::EMPTY, calculator::symbol_type::UNKNOWN, kSpace };
+    }
+
+    static Item leftBracket() {
+        return { calculator::token_type::LBRACKET, calculator::symbol_type::UNKNOWN, kLeftBracket };
+    }
+
+    // OperationComplementer: a symbol whose completion changes its length
+    // is replaced by it, an empty completion drops the symbol
+    void completeOperations() {
+        std::vector<Item> items;
+        items.reserve(items_.size());
+        for (auto& item : items_) {
+            if (item.type != calculator::token_type::SYMBOL) {
+                items.push_back(item);
+                continue;
+            }
+
+            auto [text, type] = Symbol::refreshed(std::wstring{ item.text });
+            if (text.size() == item.text.size()) {
+                items.push_back(item);
+                continue;
+            }
+            if (text.empty())
+                continue;
+
+            auto& stored = completions_.emplace_back(std::move(text));
+            items.push_back({ item.type, type, stored });
+        }
+        items_ = std::move(items);
+    }
+
+    // BinaryOperationSpaceComplementer: spaces around binary operations and
+    // around a minus that follows a number
+    void spaceBinaryOperations() {
+        std::vector<Item> items;
+        items.reserve(items_.size() * 2);
+        for (size_t i = 0; i < items_.size(); ++i) {
+            auto prev = (i > 0) ? items_[i - 1].type : calculator::token_type::EMPTY;
+            auto spaced = FormatRules::isSpaced(operation(items_[i]), prev);
+
+            if (spaced && i > 0)
+                items.push_back(space());
+            items.push_back(items_[i]);
+            if (spaced)
+                items.push_back(space());
+        }
+        items_ = std::move(items);
+    }
+
+    // UnaryOperationLeftBracketComplementer: functions get an opening
+    // bracket unless one follows them already
+    void bracketUnaryOperations() {
+        std::vector<Item> items;
+        items.reserve(items_.size() * 2);
+        for (size_t i = 0; i < items_.size(); ++i) {
+            items.push_back(items_[i]);
+
+            if (!FormatRules::takesLeftBracket(operation(items_[i])))
+                continue;
+
+            if (i + 1 == items_.size() || items_[i + 1].type != calculator::token_type::LBRACKET)
+                items.push_back(leftBracket());
+        }
+        items_ = std::move(items);
+    }
+
+    // MinusComplementer: a minus right after a binary operation is opened
+    // with a bracket
+    void bracketMinuses() {
+        std::vector<Item> items;
+        items.reserve(items_.size() * 2);
+        for (size_t i = 0; i < items_.size(); ++i) {
+            auto op = operation(items_[i]);
+            if (op && op->type() == calculator::symbol_type::MINUS && i > 0) {
+                auto prev = i;
+                while (prev > 0 && items_[prev - 1].type == calculator::token_type::EMPTY)
+                    --prev;
+
+                auto prev_op = (prev > 0) ? operation(items_[prev - 1]) : nullptr;
+                if (FormatRules::opensMinus(op, prev_op))
+                    items.push_back(leftBracket());
+            }
+            items.push_back(items_[i]);
+        }
+        items_ = std::move(items);
+    }
+
+private:
+    std::vector<Item> items_;
+    std::deque<std::wstring> completions_;
+};
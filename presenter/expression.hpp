@@ -2,34 +2,44 @@
 
 #include <list>
 #include <array>
+#include <limits>
+#include <memory>
+#include <cstdint>
+#include <utility>
+#include <optional>
 #include <functional>
 #include <algorithm>
 #include <QString>
 #include "model/parser.hpp"
 #include "model/eval.hpp"
+#include "model/digits.hpp"
 #include "settings.hpp"
 #include "elements.hpp"
+#include "blocktree.hpp"
+#include "tokentable.hpp"
 #include "proxylexer.hpp"
-#include "stdextension.hpp"
 
 class Expression {
-private:
-    using ContainerWrapperType  = OptimizedListWrapper<BlockPtr, 128>;
-
 public:
-    using ContainerType         = typename ContainerWrapperType::ListType;
+    using ContainerType         = BlockTree<128>;
     using BlockPtrIt            = typename ContainerType::iterator;
     
 private:
-    struct Update {
-        BlockPtrIt lastModified;
-        int offset;
+    // Parse and evaluation of one revision; the tree is left out for a
+    // result installed by evalAndUpdate() and parsed when it is needed.
+    struct Evaluation {
+        std::uint64_t revision;
+        std::optional<calculator::object_t> tree;
+        calculator::number_t value;
+        calculator::status_type status;
+        calculator::op_ptr op;
     };
 
 public:
     Expression() = default;
     Expression(const Expression& ce) : 
-        changed_{ true },
+        evaluation_{ ce.evaluation_ },
+        revision_{ ce.revision_ },
         current_position_{ ce.current_position_ }
     {
         for (auto& bl : ce.expr_)
@@ -45,38 +55,78 @@ public:
         clear();
         expr_ = std::move(tmp.expr_);
         current_position_ = tmp.current_position_;
-        changed_ = true;
+        revision_ = tmp.revision_;
+        evaluation_ = std::move(tmp.evaluation_);
+        markAllDirty();
         return *this;
     }
 
     QString getExpression() const {
-        if (changed_) {
-            changed_ = false;
-            buildExpression();
-        }
+        QString text;
+        for (auto& bl : expr_)
+            text.append(bl->toString());
+        return text;
+    }
 
-        return last_;
+    // Snapshot of the blocks for the readers that go through all of them,
+    // the lexer and the preview; the editing works on the block tree.
+    TokenTable tokens() const {
+        TokenTable table;
+        table.assign(expr_.begin(), expr_.end());
+        return table;
     }
 
     int getPosition() const noexcept {
         return current_position_;
     }
 
+    // Cursor in the shown text, where numbers carry digit gaps.
+    int getShownPosition() const {
+        return toShown(current_position_);
+    }
+
+    void setShownPosition(int pos) {
+        setPosition(fromShown(pos));
+    }
+
+    // Position in the shown text of a position in the stored one, mapped
+    // within the last block starting at or before it.
+    int toShown(int pos) const {
+        if (pos < 0 || expr_.empty())
+            return pos;
+
+        auto it = (pos < size()) ? expr_.locate(pos) : std::prev(expr_.end());
+        auto& bl = **it;
+        return expr_.shownStart(it) + NumberGaps::toShown(integerSize(bl), pos - bl.begin());
+    }
+
+    // Position in the stored text of a position in the shown one.
+    int fromShown(int pos) const {
+        if (pos < 0 || expr_.empty())
+            return pos;
+
+        auto it = (pos < expr_.shownLength()) ? expr_.locateShown(pos) : std::prev(expr_.end());
+        auto& bl = **it;
+        return bl.begin() + NumberGaps::fromShown(integerSize(bl), pos - expr_.shownStart(it));
+    }
+
+    // Advances with every user edit. Formatter edits keep it, and with it
+    // the memoized evaluation.
+    std::uint64_t revision() const noexcept {
+        return revision_;
+    }
+
+    // Occupancy of the node pool behind the block tree.
+    auto memoryStats() const noexcept {
+        return expr_.stats();
+    }
+
     int getOpenBracketsCount() const noexcept {
-        auto cnt{ 0 };
-        for (auto& bl : expr_) {
-            auto type = bl->type();
-            cnt += type == calculator::token_type::LBRACKET;
-            cnt -= type == calculator::token_type::RBRACKET;
-        }
-        return cnt;
+        return expr_.balance();
     }
 
-    int size() const {
-        auto lastit = expr_.rbegin();
-        return (lastit != expr_.rend())
-            ? (*lastit)->end()
-            : 0;
+    int size() const noexcept {
+        return expr_.length();
     }
 
     auto begin() const {
@@ -115,41 +165,78 @@ public:
             return v1.first < v2.first; 
         });
 
-        Update upd{ expr_.begin(), 0 };
+        ++revision_;
+        auto offset{ 0 };
         for (auto& v : vals) {
-            auto offset = upd.offset;
             auto pos = v.first + offset;
-            upd = insertOne(upd.lastModified, offset, pos, v.second);
-            updatePosition(pos, upd.offset);
-            upd.offset += offset;
+            auto [sz, end] = insertOne(pos, v.second);
+            markDirty(pos, sz, std::max(sz, end - pos));
+            updatePosition(pos, sz);
+            offset += sz;
         }
-        shiftAll(std::next_or_default(upd.lastModified, expr_.end()), expr_.end(), upd.offset);
         update();
 
         return *this;
     }
 
+    // Inserts a long text at the cursor in one pass: the text is lexed
+    // together with the mutable blocks it touches there, and those blocks
+    // are replaced with the result. Nothing is inserted inside an
+    // immutable block, as with insert().
+    Expression& insertBulk(const QString& val) {
+        // the first block ending at or after the cursor
+        auto pos = current_position_;
+        auto first = (pos > 0) ? expr_.locate(pos - 1) : expr_.begin();
+        if (first != expr_.end() && !(*first)->isMutable() && (*first)->end() == pos)
+            ++first;
+        if (first != expr_.end() && !(*first)->isMutable() && (*first)->begin() < pos)
+            return *this;
+
+        auto last = first;
+        while (last != expr_.end() && (*last)->begin() <= pos && (*last)->isMutable())
+            ++last;
+
+        auto start = (first != last) ? (*first)->begin() : pos;
+        QString text;
+        for (auto it = first; it != last; ++it)
+            text.append((*it)->toString(false));
+        auto old_sz = text.size();
+        auto right_sz = old_sz - (pos - start);
+        text.insert(pos - start, val);
+
+        auto blocks = Block::create(start, text);
+        auto new_sz = !blocks.list.empty()
+            ? blocks.list.back()->end() - start
+            : 0;
+
+        ++revision_;
+        auto next = eraseBlocks(first, last);
+        for (auto& bl : blocks)
+            expr_.insert(next, std::move(bl));
+        markDirty(start, new_sz - old_sz, new_sz);
+        current_position_ = std::max(start, start + new_sz - right_sz);
+        update();
+
+        return *this;
+    }
+
+    // Blocks for one position go in the order they come.
     Expression& insertBlockRange(std::vector<std::pair<int, BlockPtr>> vals) {
-        std::sort(vals.begin(), vals.end(), [](const auto& v1, const auto& v2) { 
+        std::stable_sort(vals.begin(), vals.end(), [](const auto& v1, const auto& v2) { 
             return v1.first < v2.first; 
         });
 
-        Update upd{ expr_.begin(), 0 };
+        auto offset{ 0 };
         for (auto& v : vals) {
-            auto offset = upd.offset;
-            auto pos = v.first + offset;
-            auto next = selectFirstSuitable(upd.lastModified, offset, pos);
+            auto next = expr_.locate(v.first + offset);
             auto bl_sz = v.second->size();
             auto start = (next != expr_.end()) ? (*next)->begin() : size();
-            v.second->shift(-v.second->begin() + start);
-            if (next != expr_.end())
-                (*next)->shift(bl_sz);
             expr_.insert(next, std::move(v.second));
+            markDirty(start, bl_sz, bl_sz);
+            extendRange(carried_begin_, carried_end_, start, 0, bl_sz);
             updatePosition(start, bl_sz);
-            upd.offset += bl_sz;
-            upd.lastModified = next;
+            offset += bl_sz;
         }
-        shiftAll(std::next_or_default(upd.lastModified, expr_.end()), expr_.end(), upd.offset);
         update();
 
         return *this;
@@ -172,15 +259,15 @@ public:
             return v1.first < v2.first; 
         });
 
-        Update upd{ expr_.begin(), 0 };
+        ++revision_;
+        auto offset{ 0 };
         for (auto& v : vals) {
-            auto offset = upd.offset;
             auto pos = v.first - offset;
-            upd = removeOne(upd.lastModified, offset, pos, v.second);
-            updatePosition(pos, -upd.offset);
-            upd.offset += offset;
+            auto sz = removeOne(pos, v.second);
+            markDirty(pos, -sz, 0);
+            updatePosition(pos, -sz);
+            offset += sz;
         }
-        shiftAll(std::next_or_default(upd.lastModified, expr_.end()), expr_.end(), -upd.offset);
         update();
 
         return *this;
@@ -191,44 +278,65 @@ public:
             return v1 < v2; 
         });
 
-        Update upd{ expr_.begin(), 0 };
+        auto offset{ 0 };
         for (auto& v : vals) {
-            auto offset = upd.offset;
-            auto pos = v - offset;
-            auto cur = selectFirstSuitable(upd.lastModified, -offset, pos);
+            auto cur = expr_.locate(v - offset);
             if (cur == expr_.end())
                 break;
 
+            auto start = (*cur)->begin();
             auto sz = (*cur)->size();
-            updatePosition((*cur)->begin(), -sz);
-
-            upd.lastModified = expr_.erase(cur);
-            upd.offset += sz;
-            if (upd.lastModified != expr_.end())
-                (*upd.lastModified)->shift(-upd.offset);
+            markDirty(start, -sz, 0);
+            updatePosition(start, -sz);
+            expr_.erase(cur);
+            offset += sz;
         }
-        shiftAll(std::next_or_default(upd.lastModified, expr_.end()), expr_.end(), -upd.offset);
         update();
 
         return *this;
     }
 
+    // Applies a formatter's edits; without any only the layout is refreshed.
+    // Formatters keep the value of the expression, so their edits keep the
+    // revision.
+    Expression& applyEdits(std::vector<std::pair<int, BlockPtr>> inserts, std::vector<int> removes) {
+        auto untouched = inserts.empty() && removes.empty();
+        if (!inserts.empty())
+            insertBlockRange(std::move(inserts));
+        if (!removes.empty())
+            removeBlockRange(std::move(removes));
+        if (untouched)
+            update();
+
+        return *this;
+    }
+
     std::tuple<Expression, calculator::status_type, calculator::op_ptr> eval() const {
-        auto lexer = ProxyLexer{ *this };
-        auto [obj, st] = calculator::parse(std::move(lexer));
+        auto& ev = evaluate();
 
         Expression expr;
-        if (st != calculator::status_type::PARTLY_INVALID_EXPR)
-            return { expr, st, nullptr };
+        if (ev.status != calculator::status_type::OK)
+            return { expr, ev.status, ev.op };
 
-        auto [res, est, op] = calculator::eval(obj, Settings::precision);
-        if (est != calculator::status_type::OK)
-            return { expr, est, op};
-
-        expr.expr_.emplace_back(new Number(0, res));
+        expr.expr_.push_back(BlockPtr{ new Number(0, ev.value) });
         expr.current_position_ = expr.size();
 
-        return { expr, est, nullptr};
+        return { expr, ev.status, nullptr};
+    }
+
+    std::tuple<calculator::digit_expansion, calculator::status_type, calculator::op_ptr> expand() const {
+        auto& ev = evaluate();
+        if (ev.status != calculator::status_type::OK)
+            return { calculator::digit_expansion{}, ev.status, ev.op };
+
+        auto tree = ev.tree
+            ? *ev.tree
+            : std::get<0>(calculator::parse(ProxyLexer{ tokens() }));
+        return { 
+            calculator::digit_expansion{ std::move(tree) }, 
+            ev.status, 
+            nullptr 
+        };
     }
 
     std::pair<calculator::status_type, calculator::op_ptr> evalAndUpdate() {
@@ -237,9 +345,15 @@ public:
         if (st != calculator::status_type::OK)
             return { st, op };
 
+        auto value = evaluation_->value;
         clear();
         expr_ = std::move(res.expr_);
         current_position_ = res.current_position_;
+        // the result evaluates to itself
+        evaluation_ = std::make_shared<const Evaluation>(Evaluation{
+            revision_, std::nullopt, std::move(value), st, nullptr
+        });
+        markAllDirty();
         update();
 
         return { st, nullptr };
@@ -260,44 +374,104 @@ public:
 
     template<typename Formatter = void>
     void update() {
-        last_.clear();
-        changed_ = true;
         if constexpr (!std::is_same_v<Formatter, void>)
             applyFormatFeatures<Formatter>();
+        // a result number goes as a whole, which may take the cursor with it
+        current_position_ = std::min(current_position_, size());
     }
 
     void clear() {
         expr_.clear();
+        expr_.compact();
         current_position_ = 0;
+        carried_begin_ = kWhole;
+        carried_end_ = 0;
+        ++revision_;
+        markAllDirty();
         update();
     }
 
-private:
-    BlockPtrIt getLast() {
-        return std::next_or_default(expr_.rbegin(), expr_.rend(), expr_.rbegin()).base();
+    // Blocks edited since the last formatting with the neighbours formatters
+    // look at: one block before them and the spaces after them up to the
+    // next block. Both ends are found in the block tree.
+    std::pair<BlockPtrIt, BlockPtrIt> dirtyBlocks() {
+        if (dirty_begin_ > dirty_end_)
+            return { expr_.end(), expr_.end() };
+        if (dirty_end_ == kWhole)
+            return { expr_.begin(), expr_.end() };
+
+        auto first = startingAtOrBefore(dirty_begin_ - 1);
+        if (first == expr_.end())
+            first = expr_.begin();
+        else if (first != expr_.begin())
+            --first;
+
+        auto last = startingAtOrBefore(dirty_end_);
+        last = (last != expr_.end()) ? std::next(last) : expr_.begin();
+        if (last != expr_.end())
+            ++last;
+        while (last != expr_.end() && (*std::prev(last))->type() == calculator::token_type::EMPTY)
+            ++last;
+
+        return { first, last };
     }
 
-    Update insertOne(BlockPtrIt last_modified, int offset, int pos, const QString& val) {
-        BlockPtrIt 
-            curit = selectFirstSuitable(last_modified, offset, pos),
-            previt = std::prev_or_default(curit, expr_.begin(), expr_.end(), expr_.end(), getLast()),
-            nextit = curit;
+    void markAllDirty() noexcept {
+        dirty_begin_ = 0;
+        dirty_end_ = kWhole;
+    }
+
+    // What formatters inserted stays dirty for the next formatting, as their
+    // flags may still ask for work on it.
+    void markFormatted() noexcept {
+        dirty_begin_ = std::exchange(carried_begin_, kWhole);
+        dirty_end_ = std::exchange(carried_end_, 0);
+    }
 
-        Update upd;
+private:
+    // Every consumer of one revision shares a single parse and evaluation.
+    // Blocks keep their own tokens, but the table and the parse are built
+    // over the whole text for every revision; only brackets the edit left
+    // alone come from eval_cache_ instead of being evaluated again.
+    const Evaluation& evaluate() const {
+        if (evaluation_ && evaluation_->revision == revision_)
+            return *evaluation_;
+
+        auto table = tokens();
+        auto [obj, st] = calculator::parse(ProxyLexer{ table });
+        Evaluation ev{ revision_, std::move(obj), 0, st, nullptr };
+        if (st == calculator::status_type::PARTLY_INVALID_EXPR)
+            std::tie(ev.value, ev.status, ev.op) = calculator::eval(*ev.tree, eval_cache_, Settings::precision);
+
+        evaluation_ = std::make_shared<const Evaluation>(std::move(ev));
+        return *evaluation_;
+    }
+
+    // Inserts val at pos and returns how much the text grew and where the
+    // blocks made for it end, which may be past the inserted text when a
+    // block is lexed again. The text goes into the block at pos when it
+    // takes it, which splits the block if it takes only part of it;
+    // otherwise it is merged with the mutable blocks on both sides of pos.
+    // Nothing goes inside an immutable block.
+    std::pair<int, int> insertOne(int pos, const QString& val) {
         auto blocks = Block::create(pos, val);
         if (blocks.list.empty())
-            return { curit, 0 };
+            return { 0, pos };
 
+        auto sz = size();
+        auto curit = expr_.locate(pos);
+        auto previt = (curit != expr_.begin()) ? std::prev(curit) : expr_.end();
         if (curit != expr_.end()) {
-            upd = tryInsertToBlock(curit, pos, blocks);
-            if (upd.offset)
-                return upd;
+            auto end = tryInsertToBlock(curit, pos, blocks);
+            if (size() != sz)
+                return { size() - sz, end };
         }
 
         if ((previt != expr_.end() && (*previt)->end() != pos) ||
             (curit != expr_.end() && (*curit)->begin() != pos))
-            return { curit, 0 };
+            return { 0, pos };
 
+        auto nextit = curit;
         OptimizedListWrapper<BlockPtrIt, 2> delete_lst;
         if (previt != expr_.end() && (*previt)->isMutable()) {
             blocks.list.push_front((*previt)->clone());
@@ -306,33 +480,35 @@ private:
 
         if (curit != expr_.end() && (*curit)->isMutable()) {
             blocks.list.push_back((*curit)->clone());
-            nextit = std::next_or_default(curit, expr_.end(), expr_.end());
+            nextit = std::next(curit);
             delete_lst.list.push_back(curit);
         }
 
-        upd = mergeInto(nextit, blocks);
+        mergeInto(nextit, blocks);
         for (auto& it : delete_lst)
             expr_.erase(it);
 
-        return upd;
+        return { size() - sz, (nextit != expr_.end()) ? (*nextit)->begin() : size() };
     }
 
-    Update removeOne(BlockPtrIt last_modified, int offset, int pos, int count) {
-        auto curit = selectFirstSuitable(last_modified, -offset, pos);
+    // Removes count characters from pos on and returns how many went, which
+    // is more when an immutable block goes as a whole. The block left at
+    // pos is merged with the one before it.
+    int removeOne(int pos, int count) {
+        auto curit = expr_.locate(pos);
         if (curit == expr_.end())
-            return { curit, 0 };
+            return 0;
 
+        auto sz = size();
         auto total{ 0 };
         while (total < count) {
             auto& cur = *curit;
-            auto cnt = cur->remove(pos, count - total);
-            total += cnt;
+            total += cur->remove(pos, count - total);
 
             if (cur->isInside(pos))
-                return { curit, total };
+                return sz - size();
 
-            bool empty = cur->empty();
-            if (empty) {
+            if (cur->empty()) {
                 pos = cur->begin();
                 curit = expr_.erase(curit);
             }
@@ -340,56 +516,82 @@ private:
                 curit = std::next(curit);
 
             if (curit == expr_.end())
-                return { curit, total };
-
-            if (empty || total < count) 
-                (*curit)->shift(-(total + offset));
+                return sz - size();
         }
 
         if (curit == expr_.begin())
-            return { curit, total };
-
-        BlockPtrIt
-            previt{ std::prev(curit) },
-            nextit{ std::next(curit) };
+            return sz - size();
 
+        auto previt = std::prev(curit);
+        auto nextit = std::next(curit);
         if (!(*previt)->isMutable())
-            return { curit, total };
+            return sz - size();
 
         BlockPtrList lst;
         lst.list.push_back((*previt)->clone());
         lst.list.push_back((*curit)->clone());
-        auto res = mergeInto(nextit, lst);
+        mergeInto(nextit, lst);
         expr_.erase(previt);
         expr_.erase(curit);
 
-        res.offset = total - res.offset;
-        return res;
+        return sz - size();
     }
 
-    BlockPtrIt selectFirstSuitable(BlockPtrIt last_modified, int offset, int pos) {
-        auto end = expr_.end();
+    // length of the integer part of a number, where its digit gaps go
+    static int integerSize(const Block& bl) {
+        return (bl.type() == calculator::token_type::NUMBER)
+            ? NumberGaps::integerSize(bl.toString(false).toStdWString())
+            : 0;
+    }
 
-        if (last_modified == end || (*last_modified)->isInside(pos))
-            return last_modified;
+    BlockPtrIt eraseBlocks(BlockPtrIt first, BlockPtrIt last) {
+        while (first != last)
+            first = expr_.erase(first);
+        return last;
+    }
 
-        for (auto it = std::next(last_modified); it != end; ++it) {
-            auto& cur = *it;
-            cur->shift(offset);
-            if (cur->isInside(pos))
-                return it;
+    // Records for the formatters an edit at pos that moved the text after
+    // it by shift and left length new characters there.
+    void markDirty(int pos, int shift, int length) noexcept {
+        extendRange(dirty_begin_, dirty_end_, pos, shift, length);
+        if (carried_begin_ <= carried_end_)
+            extendRange(carried_begin_, carried_end_, pos, shift, length);
+    }
+
+    static void extendRange(int& begin, int& end, int pos, int shift, int length) noexcept {
+        if (begin > end) {
+            begin = pos;
+            end = pos + length;
+            return;
         }
 
-        return end;
-    }
+        if (end != kWhole && end >= pos)
+            end = std::max(pos, end + shift);
+        if (begin > pos)
+            begin = std::max(pos, begin + shift);
 
-    Update tryInsertToBlock(BlockPtrIt block_it, int pos, BlockPtrList& bucket) {
-        auto& bucketList = bucket.list;
+        begin = std::min(begin, pos);
+        if (end != kWhole)
+            end = std::max(end, pos + length);
+    }
 
-        Update res{ block_it, 0 };
-        auto& shift = res.offset;
+    // last block starting at or before pos, end() when there is none
+    BlockPtrIt startingAtOrBefore(int pos) noexcept {
+        if (pos < 0 || expr_.empty())
+            return expr_.end();
+        return (pos < size())
+            ? expr_.locate(pos)
+            : std::prev(expr_.end());
+    }
 
+    // Puts what the block takes of the bucket into it. When the rest can
+    // not go there, the block is split at pos and its parts are merged with
+    // the rest in its place. Returns the end of what changed.
+    int tryInsertToBlock(BlockPtrIt block_it, int pos, BlockPtrList& bucket) {
+        auto& bucketList = bucket.list;
         auto& block = *block_it;
+
+        auto shift{ 0 };
         while (!bucketList.empty()) {
             auto cur = bucketList.front()->clone();
             auto sh = block->insert(pos + shift, *cur);
@@ -399,7 +601,7 @@ private:
         }
         pos += shift;
         if (bucketList.empty() || !block->canSplit(pos))
-            return res;
+            return pos;
 
         auto [vbl, vbr, soff] = block->split(pos);
         bucketList.insert(
@@ -414,45 +616,36 @@ private:
         );
 
         auto next = std::next(block_it);
-        res = mergeInto(next, bucket);
+        mergeInto(next, bucket);
         expr_.erase(block_it);
-
-        return res;
+        return (next != expr_.end()) ? (*next)->begin() : size();
     }
 
-    Update mergeInto(BlockPtrIt dest, BlockPtrList& list) {
-        Update res;
+    // Merges the blocks of the list with each other where they take it and
+    // inserts the result before dest.
+    void mergeInto(BlockPtrIt dest, BlockPtrList& list) {
         auto begin = list.list.front()->begin();
-        auto end = (dest == expr_.end()) ? size() : (*dest)->begin();
         auto blocks = Block::merge(begin, list);
-        res.offset = blocks.list.back()->end() - end;
         for (auto& b : blocks)
-            res.lastModified = expr_.insert(dest, std::move(b));
-        return res;
-    }
-
-    void shiftAll(BlockPtrIt begin, BlockPtrIt end, int val) {
-        std::for_each(begin, end, [&val](auto &ptr) { ptr->shift(val);});
+            expr_.insert(dest, std::move(b));
     }
 
     template<typename Formatter>
     void applyFormatFeatures() {
-        for (auto f : Formatter(*this, expr_))
-            for (auto it = expr_.begin(); it != expr_.end(); ++it)
-                f(it);
-    }
-
-    void buildExpression() const {
-        last_.clear();
-        for(auto &bl : expr_)
-            last_.append(bl->toString());
+        Formatter::apply(*this, expr_);
     }
 
 private:
-    mutable QString last_;
-    mutable bool changed_{ true };
+    static constexpr int kWhole = std::numeric_limits<int>::max();
+
+    mutable calculator::eval_cache eval_cache_;
+    mutable std::shared_ptr<const Evaluation> evaluation_;
 
+    std::uint64_t revision_{ 0 };
     int current_position_{ 0 };
-    ContainerWrapperType exprWrapper_;
-    ContainerType& expr_ = exprWrapper_.list;
+    // text range edited since the last formatting, empty when reversed
+    int dirty_begin_{ 0 }, dirty_end_{ kWhole };
+    // blocks inserted by the formatters, dirty again after the formatting
+    int carried_begin_{ kWhole }, carried_end_{ 0 };
+    ContainerType expr_;
 };
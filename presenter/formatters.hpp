@@ -1,35 +1,108 @@
 #pragma once
 
-#include <array>
+#include <algorithm>
+#include <optional>
+#include <tuple>
 #include <vector>
-#include <functional>
-#include <QRegularExpression>
 #include "model/op.hpp"
 #include "elements.hpp"
 
+// Decisions of the formatters that EvalView replays over a token table, so
+// that the two agree on the formatted text.
+struct FormatRules {
+    static calculator::op_ptr operation(calculator::token_type type, calculator::symbol_type symbol) {
+        if (type != calculator::token_type::SYMBOL)
+            return nullptr;
+
+        auto it = calculator::operations().find(symbol);
+        return (it != calculator::operations().end())
+            ? it->second
+            : nullptr;
+    }
+
+    static calculator::op_ptr operation(const Block& bl) {
+        return (bl.type() == calculator::token_type::SYMBOL)
+            ? operation(bl.type(), static_cast<const Symbol&>(bl).symbol_type())
+            : nullptr;
+    }
+
+    // binary operations and a minus that follows a number
+    static bool isSpaced(const calculator::op_ptr& op, calculator::token_type prev) {
+        if (!op)
+            return false;
+
+        return (op->type() == calculator::symbol_type::MINUS)
+            ? prev == calculator::token_type::NUMBER
+            : op->category() == calculator::op_category::BINARY;
+    }
+
+    // functions, which excludes the unary minus and the factorial
+    static bool takesLeftBracket(const calculator::op_ptr& op) {
+        return op &&
+            op->category() == calculator::op_category::UNARY &&
+            op->type() != calculator::symbol_type::MINUS &&
+            op->type() != calculator::symbol_type::FACT;
+    }
+
+    // a minus right after a binary operation, spaces aside
+    static bool opensMinus(const calculator::op_ptr& op, const calculator::op_ptr& prev) {
+        return op && op->type() == calculator::symbol_type::MINUS &&
+            prev && prev->category() == calculator::op_category::BINARY;
+    }
+};
+
+// Blocks a formatting has to visit: the ones edited since the last one with
+// their neighbours, every block, or the ones up to the end of the text for
+// a formatter that adds there. A block outside the edited neighbourhood
+// would get the same decision as when it was last visited.
+enum class FormatScope {
+    DIRTY,
+    EVERYTHING,
+    LAST
+};
+
+// Block on its way through the formatters: one of the expression or one a
+// formatter made. A dropped block is passed on only to keep its place among
+// the edits. Stage is the formatter that made or dropped it.
+struct FormatItem {
+    Block* block;
+    BlockPtr made;
+    bool dropped{ false };
+    int stage{ -1 };
+
+    static FormatItem make(Block* bl) {
+        return { bl, BlockPtr{ bl } };
+    }
+};
+
+// Neighbours of a block in the text the formatters before this one left:
+// the previous block, the last one before it that is not a space and the
+// next one, null at the ends of the text.
+struct FormatView {
+    const Block* prev{ nullptr };
+    const Block* solid{ nullptr };
+    const Block* next{ nullptr };
+};
+
+// Length and bracket balance of the text a formatter sees.
+struct FormatTotals {
+    int length{ 0 };
+    int balance{ 0 };
+
+    void add(const Block& bl, int sign) {
+        length += sign * bl.size();
+        balance += sign * ((bl.type() == calculator::token_type::LBRACKET) -
+            (bl.type() == calculator::token_type::RBRACKET));
+    }
+};
+
 template<class ExprT, class ContT>
 struct FormatterBase {
-    using iterator_t  = typename ContT::iterator;
-
-    ExprT &expr_;
-    ContT &cont_;
-    std::vector<std::pair<int, BlockPtr>> to_insert_;
-    std::vector<int> to_remove_;
-
-    FormatterBase() = delete;
-    FormatterBase(ExprT &expr, ContT &cont) :
-        expr_{ expr }, 
-        cont_{ cont }
-    { }
-
-    FormatterBase(const FormatterBase& fb) :
-        FormatterBase(fb.expr_, fb.cont_)
-    { }
-
-    ~FormatterBase() {
-        expr_.insertBlockRange(std::move(to_insert_));
-        expr_.removeBlockRange(std::move(to_remove_));
-    }
+    static constexpr FormatScope scope = FormatScope::DIRTY;
+
+    // what the formatter adds past the last block
+    template<class Out>
+    void finish(const FormatTotals&, Out&&) { }
 };
 
 template<int Id>
@@ -38,80 +111,246 @@ struct FormatterOrder {
     static constexpr int id = Id;
 };
 
+// Runs the formatters in one traversal of the blocks. Each formatter is a
+// stage that decides on a block once the next block of its input is known,
+// and passes on what it leaves to the next stage, so every formatter sees
+// the text the ones before it left, as if they ran one after another, and
+// the edits of all of them go to the expression as one batch.
 template<class ExprT, template<typename... Args> typename... Formatters>
 struct Formatter {
     using container_t = typename ExprT::ContainerType;
-    using func_t = std::function<void(typename FormatterBase<ExprT, container_t>::iterator_t)>;
-
-    ExprT& expr_;
-    container_t& cont_;
-    const std::array<func_t, sizeof... (Formatters)> formatters_;
 
     Formatter() = delete;
-    Formatter(ExprT& expr, container_t& cont) : 
-        expr_{ expr },
-        cont_{ cont },
-        formatters_ { func_t{Formatters<ExprT, container_t>{expr, cont}}...  }
-    { }
-
-    auto begin() { 
-        return formatters_.begin(); 
+
+    static void apply(ExprT& expr, container_t& cont) {
+        traverse(expr, cont);
+        expr.markFormatted();
+    }
+
+    // The traversal and its edits, leaving the edited region dirty.
+    static void traverse(ExprT& expr, container_t& cont) {
+        if constexpr (((Formatters<ExprT, container_t>::scope == FormatScope::EVERYTHING) || ...))
+            expr.markAllDirty();
+
+        auto [first, last] = expr.dirtyBlocks();
+        if constexpr (((Formatters<ExprT, container_t>::scope == FormatScope::LAST) || ...))
+            last = cont.end();
+
+        // the blocks around the range, which the formatting leaves as they are
+        FormatView view;
+        for (auto it = first; it != cont.begin();) {
+            auto bl = (--it)->get();
+            if (!view.prev)
+                view.prev = bl;
+            if (bl->type() != calculator::token_type::EMPTY) {
+                view.solid = bl;
+                break;
+            }
+        }
+        auto next = (last != cont.end()) ? last->get() : nullptr;
+
+        FormatTotals totals{ expr.size(), expr.getOpenBracketsCount() };
+        auto index{ 0 };
+        Stages stages{ Stage<Formatters<ExprT, container_t>>{ {}, index++, view, totals }... };
+        Batch batch{ (first != cont.end()) ? (*first)->begin() : expr.size() };
+        for (auto it = first; it != last; ++it)
+            push<0>(stages, batch, FormatItem{ it->get() });
+        flush<0>(stages, batch, next);
+        batch.close();
+
+        expr.applyEdits(std::move(batch.inserts), std::move(batch.removes));
     }
 
-    auto end() { 
-        return formatters_.end(); 
+private:
+    // A formatter with the block it waits to decide on and the dropped
+    // blocks that came after it.
+    template<class F>
+    struct Stage {
+        F formatter;
+        int index;
+        FormatView view;
+        FormatTotals totals;
+        std::optional<FormatItem> pending;
+        std::vector<FormatItem> held;
+
+        template<class Out>
+        void push(FormatItem&& item, Out&& out) {
+            if (item.made && !item.dropped)
+                totals.add(*item.block, 1);
+            else if (!item.made && item.dropped)
+                totals.add(*item.block, -1);
+
+            if (item.dropped) {
+                if (pending)
+                    held.push_back(std::move(item));
+                else
+                    out(std::move(item));
+                return;
+            }
+
+            if (pending)
+                decide(item.block, out);
+            pending = std::move(item);
+        }
+
+        template<class Out>
+        void flush(const Block* next, Out&& out) {
+            if (pending)
+                decide(next, out);
+            formatter.finish(totals, stamped(out));
+        }
+
+        template<class Out>
+        void decide(const Block* next, Out& out) {
+            auto bl = pending->block;
+            view.next = next;
+            formatter(std::move(*pending), view, stamped(out));
+            pending.reset();
+
+            view.prev = bl;
+            if (bl->type() != calculator::token_type::EMPTY)
+                view.solid = bl;
+            for (auto& item : held)
+                out(std::move(item));
+            held.clear();
+        }
+
+        // passes on what the formatter emits, marked with this stage
+        template<class Out>
+        auto stamped(Out& out) {
+            return [this, &out](FormatItem&& item) {
+                if ((item.made || item.dropped) && item.stage < 0)
+                    item.stage = index;
+                out(std::move(item));
+            };
+        }
+    };
+
+    using Stages = std::tuple<Stage<Formatters<ExprT, container_t>>...>;
+
+    // Edits the items leaving the last stage make. A block goes into the text
+    // as it was, right after the blocks its formatter saw before it, so
+    // blocks dropped by the formatters before that one are behind it as if
+    // they were gone already; removals follow all insertions.
+    struct Batch {
+        // end of the last kept block in the text as it was
+        int pos{ 0 };
+        // length of the first counted insertions, which go before pos
+        int added{ 0 };
+        size_t counted{ 0 };
+        // dropped blocks from pos on
+        std::vector<FormatItem> dropped;
+        std::vector<std::pair<int, BlockPtr>> inserts;
+        std::vector<int> removes;
+        // made and dropped again, kept while stages may look at them
+        std::vector<BlockPtr> discarded;
+
+        void add(FormatItem&& item) {
+            if (item.made && item.dropped) {
+                discarded.push_back(std::move(item.made));
+                return;
+            }
+
+            if (item.made) {
+                auto at = pos, end = pos;
+                for (auto& bl : dropped) {
+                    end += bl.block->size();
+                    if (bl.stage >= item.stage)
+                        at = end;
+                }
+                // not before the blocks made ahead of it
+                if (!inserts.empty())
+                    at = std::max(at, inserts.back().first);
+                inserts.push_back({ at, std::move(item.made) });
+                return;
+            }
+
+            if (item.dropped) {
+                dropped.push_back(std::move(item));
+                return;
+            }
+            close();
+            pos += item.block->size();
+        }
+
+        // Removes the dropped blocks before the current position.
+        void close() {
+            for (auto& bl : dropped) {
+                count(pos);
+                removes.push_back(pos + added);
+                pos += bl.block->size();
+            }
+            dropped.clear();
+            count(pos);
+        }
+
+        void count(int upto) {
+            for (; counted < inserts.size() && inserts[counted].first <= upto; ++counted)
+                added += inserts[counted].second->size();
+        }
+    };
+
+    template<size_t I>
+    static void push(Stages& stages, Batch& batch, FormatItem&& item) {
+        if constexpr (I == sizeof...(Formatters))
+            batch.add(std::move(item));
+        else
+            std::get<I>(stages).push(std::move(item), [&](FormatItem&& out) {
+                push<I + 1>(stages, batch, std::move(out));
+            });
     }
-};
 
-template<class ExprT, class ContT>
-struct RightBracketComplementer : FormatterBase<ExprT, ContT>, FormatterOrder<0> {
-    using typename FormatterBase<ExprT, ContT>::iterator_t;
-    using FormatterBase<ExprT, ContT>::expr_;
-    using FormatterBase<ExprT, ContT>::cont_;
-    using FormatterBase<ExprT, ContT>::to_insert_;
-    using FormatterBase<ExprT, ContT>::to_remove_;
-
-    int opened_{ 0 };
-
-    RightBracketComplementer() = delete;
-    RightBracketComplementer(ExprT& expr, ContT& cont) : FormatterBase<ExprT, ContT>(expr, cont) { }
-
-    void operator()(iterator_t it) {
-        auto& cur = *it;
-        opened_ += cur->type() == calculator::token_type::LBRACKET;
-        opened_ -= cur->type() == calculator::token_type::RBRACKET;
-        if (std::next(it) == cont_.end()) {
-            for (auto i = 0; i < opened_; ++i)
-                to_insert_.push_back({ expr_.size(), BlockPtr{ new RightBracket() } });
+    template<size_t I>
+    static void flush(Stages& stages, Batch& batch, const Block* next) {
+        if constexpr (I < sizeof...(Formatters)) {
+            std::get<I>(stages).flush(next, [&](FormatItem&& out) {
+                push<I + 1>(stages, batch, std::move(out));
+            });
+            flush<I + 1>(stages, batch, next);
         }
     }
 };
 
 template<class ExprT, class ContT>
-struct OperationComplementer : FormatterBase<ExprT, ContT>, FormatterOrder<2> {
-    using typename FormatterBase<ExprT, ContT>::iterator_t;
-    using FormatterBase<ExprT, ContT>::expr_;
-    using FormatterBase<ExprT, ContT>::cont_;
-    using FormatterBase<ExprT, ContT>::to_insert_;
-    using FormatterBase<ExprT, ContT>::to_remove_;
+struct RightBracketComplementer : FormatterBase<ExprT, ContT>, FormatterOrder<0> {
+    static constexpr FormatScope scope = FormatScope::LAST;
+
+    template<class Out>
+    void operator()(FormatItem&& cur, const FormatView&, Out&& out) {
+        out(std::move(cur));
+    }
 
-    int offset_{ 0 };
+    template<class Out>
+    void finish(const FormatTotals& totals, Out&& out) {
+        if (!totals.length)
+            return;
 
-    OperationComplementer() = delete;
-    OperationComplementer(ExprT& expr, ContT& cont) : FormatterBase<ExprT, ContT>(expr, cont) { }
+        for (auto i = 0; i < totals.balance; ++i)
+            out(FormatItem::make(new RightBracket()));
+    }
+};
 
-    void operator()(iterator_t it) {
-        auto& cur = *it;
-        auto& flags = cur->formatFlags();
-        if (cur->type() != calculator::token_type::SYMBOL)
+template<class ExprT, class ContT>
+struct OperationComplementer : FormatterBase<ExprT, ContT>, FormatterOrder<2> {
+    template<class Out>
+    void operator()(FormatItem&& cur, const FormatView&, Out&& out) {
+        auto& bl = *cur.block;
+        if (bl.type() != calculator::token_type::SYMBOL) {
+            out(std::move(cur));
             return;
+        }
 
-        auto symbol = *static_cast<Symbol*>(cur.get());
-        auto prev_type = symbol.symbol_type();
-        auto pos = symbol.begin() + offset_;
-        auto diff = symbol.refresh();
-        auto cur_type = symbol.symbol_type();
-        auto upd_sz = symbol.size();
+        auto& flags = bl.formatFlags();
+        auto& current = static_cast<const Symbol&>(bl);
+        // refreshed on a copy, made only when it changes the symbol
+        std::optional<Symbol> symbol;
+        auto diff{ 0 };
+        if (!current.isRefreshed()) {
+            symbol.emplace(current);
+            diff = symbol->refresh();
+        }
+        auto prev_type = current.symbol_type();
+        auto cur_type = symbol ? symbol->symbol_type() : prev_type;
 
         if (flags.test(id)) {
             if (cur_type != calculator::symbol_type::UNKNOWN) {
@@ -119,243 +358,89 @@ struct OperationComplementer : FormatterBase<ExprT, ContT>, FormatterOrder<2> {
                     prev_type == calculator::symbol_type::UNKNOWN && diff)
                     flags.reset(id);
             }
-        } else {
-            if (cur_type != calculator::symbol_type::UNKNOWN)
-                return;
-
+        } else if (cur_type == calculator::symbol_type::UNKNOWN) {
             if (prev_type == calculator::symbol_type::UNKNOWN)
                 flags.set(id);
+        } else {
+            out(std::move(cur));
+            return;
         }
 
-        if (!diff)
+        if (!diff) {
+            out(std::move(cur));
             return;
-
-        auto block = BlockPtr{ new Symbol(symbol) };
-        block->formatFlags() = flags;
-
-        if (diff > 0) {        
-            to_insert_.push_back({ pos, std::move(block)});
-            to_remove_.push_back(pos + upd_sz);
-            offset_ += upd_sz;
         }
-        else {
-            if (upd_sz) {
-                to_insert_.push_back({ pos, std::move(block)});
-                pos += upd_sz;
-                offset_ += upd_sz;
-            }
-            to_remove_.push_back(pos);
+
+        // the refreshed symbol takes the place of the block
+        if (symbol->size()) {
+            auto item = FormatItem::make(new Symbol(*symbol));
+            item.block->formatFlags() = flags;
+            out(std::move(item));
         }
+        cur.dropped = true;
+        out(std::move(cur));
     }
 };
 
 template<class ExprT, class ContT>
 struct BinaryOperationSpaceComplementer : FormatterBase<ExprT, ContT>, FormatterOrder<3> {
-    using typename FormatterBase<ExprT, ContT>::iterator_t;
-    using FormatterBase<ExprT, ContT>::expr_;
-    using FormatterBase<ExprT, ContT>::cont_;
-    using FormatterBase<ExprT, ContT>::to_insert_;
-
-    BinaryOperationSpaceComplementer() = delete;
-    BinaryOperationSpaceComplementer(ExprT& expr, ContT& cont) : FormatterBase<ExprT, ContT>(expr, cont) { }
-
-    void operator()(iterator_t it) {
-        auto& cur = *it;
-        auto& flags = cur->formatFlags();
-        if (cur->type() != calculator::token_type::SYMBOL ||
-            !flags.test(id))
-            return;
-
-        auto symbol = static_cast<Symbol*>(cur.get());
-        auto stype = symbol->symbol_type();
-        if (calculator::operations.find(stype) == 
-            calculator::operations.end())
+    template<class Out>
+    void operator()(FormatItem&& cur, const FormatView& view, Out&& out) {
+        auto& bl = *cur.block;
+        auto& flags = bl.formatFlags();
+        auto prev_type = view.prev ? view.prev->type() : calculator::token_type::EMPTY;
+        if (bl.type() != calculator::token_type::SYMBOL || !flags.test(id) ||
+            !FormatRules::isSpaced(FormatRules::operation(bl), prev_type)) {
+            out(std::move(cur));
             return;
-
-        auto op = calculator::operations.at(stype);
-        if (op->category() != calculator::op_category::BINARY && 
-            op->type() != calculator::symbol_type::MINUS)
-            return;
-
-        if (op->type() == calculator::symbol_type::MINUS) {
-            auto previt = std::prev_or_default(it, cont_.begin(), cont_.end(), cont_.end());
-            if (previt == cont_.end() || (*previt)->type() != calculator::token_type::NUMBER)
-                return;
         }
 
-        if (it != cont_.begin() && (*std::prev(it))->type() != calculator::token_type::EMPTY)
-            to_insert_.push_back({ cur->begin(), BlockPtr{ new Space() }});
-
-        auto next_it = std::next(it);
-        if (next_it == cont_.end() || (*next_it)->type() != calculator::token_type::EMPTY)
-            to_insert_.push_back({ cur->end(), BlockPtr{ new Space() }});
-
         flags.reset(id);
+        if (view.prev && prev_type != calculator::token_type::EMPTY)
+            out(FormatItem::make(new Space()));
+        out(std::move(cur));
+        if (!view.next || view.next->type() != calculator::token_type::EMPTY)
+            out(FormatItem::make(new Space()));
     }
 };
 
 template<class ExprT, class ContT>
 struct UnaryOperationLeftBracketComplementer : FormatterBase<ExprT, ContT>, FormatterOrder<4> {
-    using typename FormatterBase<ExprT, ContT>::iterator_t;
-    using FormatterBase<ExprT, ContT>::expr_;
-    using FormatterBase<ExprT, ContT>::cont_;
-    using FormatterBase<ExprT, ContT>::to_insert_;
-    using FormatterBase<ExprT, ContT>::to_remove_;
-
-    UnaryOperationLeftBracketComplementer() = delete;
-    UnaryOperationLeftBracketComplementer(ExprT& expr, ContT& cont) : FormatterBase<ExprT, ContT>(expr, cont) { }
-
-    void operator()(iterator_t it) {
-        auto& cur = *it;
-        auto& flags = cur->formatFlags();
-        if (cur->type() != calculator::token_type::SYMBOL ||
-            !flags.test(id))
-            return;
-
-        auto symbol = static_cast<Symbol*>(cur.get());
-        auto stype = symbol->symbol_type();
-        if (calculator::operations.find(stype) == 
-            calculator::operations.end())
-            return;
-
-        auto op = calculator::operations.at(stype);
-        if (op->category() != calculator::op_category::UNARY ||
-            op->type() == calculator::symbol_type::MINUS || 
-            op->type() == calculator::symbol_type::FACT)
+    template<class Out>
+    void operator()(FormatItem&& cur, const FormatView& view, Out&& out) {
+        auto& bl = *cur.block;
+        auto& flags = bl.formatFlags();
+        if (bl.type() != calculator::token_type::SYMBOL || !flags.test(id) ||
+            !FormatRules::takesLeftBracket(FormatRules::operation(bl))) {
+            out(std::move(cur));
             return;
+        }
 
-        auto next_it = std::next(it);
-        if (next_it == cont_.end() || (*next_it)->type() != calculator::token_type::LBRACKET)
-            to_insert_.push_back({ cur->end(), BlockPtr{ new LeftBracket() } });
         flags.reset(id);
+        out(std::move(cur));
+        if (!view.next || view.next->type() != calculator::token_type::LBRACKET)
+            out(FormatItem::make(new LeftBracket()));
     }
 };
 
 template<class ExprT, class ContT>
 struct MinusComplementer : FormatterBase<ExprT, ContT>, FormatterOrder<5> {
-    using typename FormatterBase<ExprT, ContT>::iterator_t;
-    using FormatterBase<ExprT, ContT>::expr_;
-    using FormatterBase<ExprT, ContT>::cont_;
-    using FormatterBase<ExprT, ContT>::to_insert_;
-    using FormatterBase<ExprT, ContT>::to_remove_;
-
-    MinusComplementer() = delete;
-    MinusComplementer(ExprT& expr, ContT& cont) : FormatterBase<ExprT, ContT>(expr, cont) { }
-
-    void operator()(iterator_t it) {
-        auto& cur = *it;
-        if (cur->type() != calculator::token_type::SYMBOL)
-            return;
-
-        auto symbol = static_cast<Symbol*>(cur.get());
-        auto stype = symbol->symbol_type();
-        if (calculator::operations.find(stype) ==
-            calculator::operations.end())
-            return;
-
-        auto op = calculator::operations.at(stype);
-        if (op->type() != calculator::symbol_type::MINUS || it == cont_.begin())
-            return;
-
-        auto prev_it = std::prev(it);
-        while ((*prev_it)->type() == calculator::token_type::EMPTY)
-            prev_it = std::prev_or_default(prev_it, cont_.begin(), cont_.end(), cont_.end());
-
-        if (prev_it == expr_.end())
-            return;
-        
-        auto& prev = *prev_it;
-        if (prev->type() != calculator::token_type::SYMBOL)
-            return;
-
-        auto prev_symbol = static_cast<Symbol*>(prev.get());
-        auto prev_stype = prev_symbol->symbol_type();
-
-        if (calculator::operations.find(prev_stype) == 
-            calculator::operations.end())
-            return;
-
-        auto prev_op = calculator::operations.at(prev_stype);
-        if (prev_op->category() != calculator::op_category::BINARY)
-            return;
-
-        to_insert_.push_back({ cur->begin(), BlockPtr{ new LeftBracket() }});
+    template<class Out>
+    void operator()(FormatItem&& cur, const FormatView& view, Out&& out) {
+        if (view.solid && FormatRules::opensMinus(FormatRules::operation(*cur.block), FormatRules::operation(*view.solid)))
+            out(FormatItem::make(new LeftBracket()));
+        out(std::move(cur));
     }
 };
 
 template<class ExprT, class ContT>
-struct NumberGapFormatter : FormatterBase<ExprT, ContT>, FormatterOrder<6> {
-    using typename FormatterBase<ExprT, ContT>::iterator_t;
-    using FormatterBase<ExprT, ContT>::expr_;
-    using FormatterBase<ExprT, ContT>::cont_;
-    using FormatterBase<ExprT, ContT>::to_insert_;
-    using FormatterBase<ExprT, ContT>::to_remove_;
-
-    static inline const QString             kGapValue = QStringLiteral(" ");
-    static constexpr int                    kGapSize = 3;
-    static inline const QRegularExpression  kFractPartMask = QRegularExpression(QStringLiteral("[.eE]"));
-
-    int offset_{ 0 };
-
-    NumberGapFormatter() = delete;
-    NumberGapFormatter(ExprT& expr, ContT& cont) : FormatterBase<ExprT, ContT>(expr, cont) { }
-
-    void operator()(iterator_t it) { 
-        auto& cur = *it;
-        auto cursor = expr_.getPosition();
-        auto inside = cur->isInside(cursor) || (std::next(it) == expr_.end() && cursor == expr_.size());
-        if (inside)
-            cursor = expr_.shiftPosition(offset_);
-        cur->shift(offset_);
-        if (cur->type() != calculator::token_type::NUMBER)
-            return;
+struct Reformatter : FormatterBase<ExprT, ContT>, FormatterOrder<7> {
+    static constexpr FormatScope scope = FormatScope::EVERYTHING;
 
-        if (inside)
-            expr_.shiftPosition(-cur->getDelimetersSizeByPos(cursor));
-        offset_ += cur->clearFromDelimeters();
-        QString str = cur->toString();
-        auto order_pos = str.indexOf(kFractPartMask);
-        if (order_pos != -1)
-            str.remove(order_pos, str.size() - order_pos);
-
-        auto mod = str.size() % kGapSize;
-        auto gsz = kGapValue.size();
-        auto cur_sz = str.size();
-        auto insert_pos = (!mod ? kGapSize : mod) - gsz;
-        while (insert_pos < cur_sz - gsz) {
-            insert_pos += gsz;
-            cur->insertDelimeter(insert_pos, kGapValue);
-            if (inside)
-                expr_.updatePosition(insert_pos, gsz);
-            insert_pos += kGapSize;
-            cur_sz += gsz;
-            offset_ += gsz;
-        }
+    template<class Out>
+    void operator()(FormatItem&& cur, const FormatView&, Out&& out) {
+        cur.block->formatFlags() = Block::kFullFlags;
+        cur.dropped = cur.block->type() == calculator::token_type::EMPTY;
+        out(std::move(cur));
     }
 };
-
-template<class ExprT, class ContT>
-struct Reformatter : FormatterBase<ExprT, ContT>, FormatterOrder<7> {
-    using typename FormatterBase<ExprT, ContT>::iterator_t;
-    using FormatterBase<ExprT, ContT>::expr_;
-    using FormatterBase<ExprT, ContT>::cont_;
-    using FormatterBase<ExprT, ContT>::to_remove_;
-
-    int offset_{ 0 };
-
-    Reformatter() = delete;
-    Reformatter(ExprT& expr, ContT& cont) : FormatterBase<ExprT, ContT>(expr, cont) { }
-
-    void operator()(iterator_t it) {
-        auto& cur = *it;
-        cur->shift(-offset_);
-        cur->formatFlags() = Block::kFullFlags;
-        if (cur->type() == calculator::token_type::EMPTY) {
-            to_remove_.push_back(cur->begin());
-            return;
-        }
-        auto cursor = expr_.getPosition();
-        expr_.shiftPosition(-cur->getDelimetersSizeByPos(cursor));
-        offset_ += cur->clearFromDelimeters();
-    }
-};
\ No newline at end of file
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <QString>
+#include <QFontMetrics>
+
+// Advance widths of single characters in one font, measured once each.
+// Their sums stand for the width of a text, so widths of its parts come
+// from prefix sums instead of measuring every candidate string.
+class GlyphAdvances {
+public:
+    GlyphAdvances() = delete;
+    explicit GlyphAdvances(QFontMetrics metrics) : 
+        metrics_{ std::move(metrics) }
+    { }
+
+    int width(const QString& text) const {
+        return metrics_.width(text);
+    }
+
+    int advance(QChar ch) {
+        auto [it, added] = advances_.try_emplace(ch.unicode(), 0);
+        if (added)
+            it->second = metrics_.width(ch);
+        return it->second;
+    }
+
+    // widths of the last 0, 1, ..., text.size() characters of the text
+    std::vector<int> suffixSums(const QString& text) {
+        std::vector<int> sums;
+        sums.reserve(text.size() + 1);
+        sums.push_back(0);
+        for (auto i = text.size() - 1; i >= 0; --i)
+            sums.push_back(sums.back() + advance(text[i]));
+        return sums;
+    }
+
+private:
+    QFontMetrics metrics_;
+    std::unordered_map<char16_t, int> advances_;
+};
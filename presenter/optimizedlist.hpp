@@ -1,10 +1,119 @@
 #pragma once
 
 #include <list>
+#include <new>
 #include <cstddef>
-#include <array>
+#include <algorithm>
+#include <functional>
 #include <memory_resource>
 
+// Pool of equally sized list nodes. The first Size nodes live in an inline
+// buffer, further ones are taken from the upstream resource one at a time.
+// Freed nodes go to a free list and are handed out again before anything
+// new is allocated, so the footprint follows the peak length of the list
+// rather than the number of edits made to it.
+template<size_t NodeSize, size_t NodeAlign, size_t Size>
+class NodePoolResource : public std::pmr::memory_resource {
+public:
+	struct Stats {
+		size_t in_use;
+		size_t peak;
+		size_t free;
+		size_t spilled;
+	};
+
+public:
+	NodePoolResource() = default;
+	NodePoolResource(const NodePoolResource&) = delete;
+	NodePoolResource& operator=(const NodePoolResource&) = delete;
+
+	~NodePoolResource() {
+		compact();
+	}
+
+	Stats stats() const noexcept {
+		return { in_use_, peak_, free_count_, spilled_ };
+	}
+
+	// Returns free nodes taken from upstream; the inline buffer stays.
+	void compact() {
+		FreeNode* kept{ nullptr };
+		while (free_) {
+			auto node = free_;
+			free_ = free_->next;
+			if (isInline(node)) {
+				node->next = kept;
+				kept = node;
+				continue;
+			}
+			upstream_->deallocate(node, kNodeSize, kNodeAlign);
+			--spilled_;
+			--free_count_;
+		}
+		free_ = kept;
+	}
+
+private:
+	struct FreeNode {
+		FreeNode* next;
+	};
+
+	static constexpr size_t kNodeAlign = std::max(NodeAlign, alignof(FreeNode));
+	static constexpr size_t kNodeSize =
+		(std::max(NodeSize, sizeof(FreeNode)) + kNodeAlign - 1) / kNodeAlign * kNodeAlign;
+
+private:
+	void* do_allocate(size_t bytes, size_t align) override {
+		if (bytes > kNodeSize || align > kNodeAlign)
+			return upstream_->allocate(bytes, align);
+
+		void* res;
+		if (free_) {
+			res = free_;
+			free_ = free_->next;
+			--free_count_;
+		} else if (used_inline_ < Size) {
+			res = buffer_ + used_inline_++ * kNodeSize;
+		} else {
+			res = upstream_->allocate(kNodeSize, kNodeAlign);
+			++spilled_;
+		}
+
+		peak_ = std::max(peak_, ++in_use_);
+		return res;
+	}
+
+	void do_deallocate(void* p, size_t bytes, size_t align) override {
+		if (bytes > kNodeSize || align > kNodeAlign) {
+			upstream_->deallocate(p, bytes, align);
+			return;
+		}
+
+		free_ = ::new (p) FreeNode{ free_ };
+		++free_count_;
+		--in_use_;
+	}
+
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+		return this == &other;
+	}
+
+	bool isInline(const void* p) const noexcept {
+		std::less<const void*> less;
+		return !less(p, buffer_) && less(p, buffer_ + sizeof(buffer_));
+	}
+
+private:
+	alignas(kNodeAlign) std::byte buffer_[Size * kNodeSize];
+	std::pmr::memory_resource* upstream_{ std::pmr::get_default_resource() };
+	FreeNode* free_{ nullptr };
+	size_t used_inline_{ 0 };
+	size_t free_count_{ 0 };
+	size_t in_use_{ 0 };
+	size_t peak_{ 0 };
+	size_t spilled_{ 0 };
+};
+
 template<typename T, size_t Size>
 class OptimizedListWrapper {
 public:
@@ -12,21 +121,22 @@ public:
 
 private:
 #ifdef _MSC_VER
-	static constexpr size_t TotalNodeSize = sizeof(
-		std::_List_node<
-			T, 
-			typename std::allocator_traits<typename ListType::allocator_type>::void_pointer
-		>
-	);
+	using NodeType = std::_List_node<
+		T, 
+		typename std::allocator_traits<typename ListType::allocator_type>::void_pointer
+	>;
 #else
-	static constexpr size_t TotalNodeSize = sizeof(std::_List_node<T>);
+	using NodeType = std::_List_node<T>;
 #endif
 
-	std::array<std::byte, Size * TotalNodeSize> buffer_;
-	std::pmr::monotonic_buffer_resource resource_{ buffer_.data(), buffer_.size() };
+	using ResourceType = NodePoolResource<sizeof(NodeType), alignof(NodeType), Size>;
+
+	ResourceType resource_;
 	std::pmr::polymorphic_allocator<T> allocator_{ &resource_ };
 
 public:
+	using Stats = typename ResourceType::Stats;
+
 	OptimizedListWrapper() = default;
 
 	template<size_t TSize>
@@ -55,6 +165,14 @@ public:
 		return list.end();
 	}
 
+	Stats stats() const noexcept {
+		return resource_.stats();
+	}
+
+	void compact() {
+		resource_.compact();
+	}
+
 public:
 	ListType list{ allocator_ };
-};
\ No newline at end of file
+};
@@ -4,28 +4,53 @@ QString Presenter::getText() const {
     return expr_.getExpression();
 }
 
+TextDiff Presenter::getTextDiff(const QString& shown) const {
+    return TextDiff::between(shown, expr_.getExpression());
+}
+
 int Presenter::getCursor() const {
-    return expr_.getPosition();
+    return expr_.getShownPosition();
 }
 
-QString Presenter::getStatus() const {
-    auto [res, st, op] = expr_.eval();
-    if (st == calculator::status_type::INVALID_EVAL)
-        return QString{};
-    if (st != calculator::status_type::OK)
-        return Translator::get(st, op);
-    auto expr = Expression{ expr_ };
-    expr.update<EvalFormatter>();
-    res.update<StableFormatter>();
-    return buildExpressionHint(expr.getExpression(), res.getExpression());
+QString Presenter::getResult(int digits) const {
+    // kept while the expression is the same, so refreshing the view
+    // re-expands nothing
+    if (!expansion_ || expansionRevision_ != expr_.revision()) {
+        auto [exp, st, op] = expr_.expand();
+        if (st == calculator::status_type::INVALID_EVAL)
+            return QString{};
+        if (st != calculator::status_type::OK)
+            return Translator::get(st, op);
+        expansion_ = std::move(exp);
+        expansionRevision_ = expr_.revision();
+    }
+
+    auto [text, st, op] = expansion_->digits(digits);
+    return (st == calculator::status_type::OK)
+        ? QString::fromStdWString(text)
+        : Translator::get(st, op);
+}
+
+void Presenter::setStatusHandler(PreviewWorker::callback_t handler) {
+    preview_.setCallback(std::move(handler));
+}
+
+void Presenter::requestStatus() {
+    preview_.submit(expr_.revision(), expr_.tokens());
+}
+
+std::optional<QString> Presenter::takeStatus(const PreviewWorker::Result& res) const {
+    if (res.revision != expr_.revision())
+        return std::nullopt;
+    return buildStatus(res.status, res.op, res.body, res.value);
 }
 
 void Presenter::setPosition(int pos) {
-    expr_.setPosition(pos);
+    expr_.setShownPosition(pos);
 }
 
 void Presenter::setStatusMetrics(QFontMetrics&& fm) {
-    statusMetrics_ = std::move(fm);
+    statusAdvances_ = GlyphAdvances{ std::move(fm) };
 }
 
 void Presenter::setStatusWidth(int maxSize) {
@@ -33,17 +58,20 @@ void Presenter::setStatusWidth(int maxSize) {
 }
 
 void Presenter::onInsert(const QString& s) {
-    expr_.insert(s);
+    if (s.size() >= Settings::bulk_insert_size)
+        expr_.insertBulk(s);
+    else
+        expr_.insert(s);
     expr_.update<StableFormatter>();
 }
 
 void Presenter::onRemove(int count) {
-    if (count >= 0)
-        expr_.remove(count);
-    else {
-        count *= -1;
-        expr_.removeRange({{ expr_.getPosition() - count, count }});
-    }
+    // count is in shown characters, digit gaps take no stored ones
+    auto cursor = expr_.getShownPosition();
+    auto from = expr_.fromShown(std::min(cursor, cursor + count));
+    auto to = expr_.fromShown(std::max(cursor, cursor + count));
+    if (from != to)
+        expr_.removeRange({{ from, to - from }});
     expr_.update<StableFormatter>();
 }
 
@@ -74,35 +102,46 @@ void Presenter::onClear() {
 
 QString Presenter::onEval() {
     auto [res, st, op] = expr_.eval();
-    auto status = (st != calculator::status_type::OK) 
-        ? Translator::get(st, op) 
-        : getStatus();
+    auto status = (st != calculator::status_type::OK)
+        ? Translator::get(st, op)
+        : buildStatus(st, op, EvalView{ expr_.tokens() }.toString(), EvalView{ res.tokens() }.toString());
+
+    // the result block only keeps the evaluated bits, so further digits
+    // are expanded from the expression it replaces
+    expansion_.reset();
+    if (st == calculator::status_type::OK)
+        expansion_ = std::get<0>(expr_.expand());
+
+    // the formatters keep the revision, so this takes the memoized value
     expr_.update<EvalFormatter>();
     expr_.evalAndUpdate();
     expr_.update<StableFormatter>();
+    expansionRevision_ = expr_.revision();
     return status;
 }
 
+QString Presenter::buildStatus(calculator::status_type st, calculator::op_ptr op, QString body, QString res) const {
+    if (st == calculator::status_type::INVALID_EVAL)
+        return QString{};
+    if (st != calculator::status_type::OK)
+        return Translator::get(st, op);
+    return buildExpressionHint(std::move(body), std::move(res));
+}
+
 QString Presenter::buildExpressionHint(QString body, QString res) const {
     static const QString hintMask{ "%1 = %2" }, rest{ "..." };
     if (body == res)
         return body;
 
     auto out = QString(hintMask).arg(body).arg(res);
-    auto sz = statusMetrics_.width(out);
-    if (sz <= statusWidth_)
+    if (statusAdvances_.width(out) <= statusWidth_)
         return out;
 
-    auto res_sz = res.size();
-    int l{ res_sz }, r{ body.size() + res_sz };
-    while (r - l > 1) {
-        auto mid = (r + l) / 2;
-        out = QString(hintMask).arg(body.mid(body.size() - mid, mid).append(rest)).arg(res);
-        if (statusMetrics_.width(out) > statusWidth_)
-            r = mid;
-        else
-            l = mid;
-    }
+    // the longest tail of the body that fits beside the result
+    auto rest_sz = statusAdvances_.width(QString(hintMask).arg(rest).arg(res));
+    auto tails = statusAdvances_.suffixSums(body);
+    auto fits = std::upper_bound(tails.begin(), tails.end(), statusWidth_ - rest_sz) - tails.begin() - 1;
+    auto l = std::max(static_cast<int>(fits), std::min(res.size(), body.size()));
 
-    return QString(hintMask).arg(body.mid(body.size() - l, l).append(rest)).arg(res);;
+    return QString(hintMask).arg(body.right(l).append(rest)).arg(res);
 }
\ No newline at end of file
@@ -4,13 +4,26 @@
 #include <QFontMetrics>
 #include "expression.hpp"
 #include "formatters.hpp"
+#include "evalview.hpp"
+#include "glyphadvances.hpp"
+#include "previewworker.hpp"
+#include "textdiff.hpp"
 #include "translator.hpp"
 
 class Presenter {
 public:
 	QString getText()	const;
+	// edit turning the shown text into the current one
+	TextDiff getTextDiff(const QString& shown) const;
 	int		getCursor() const;
-	QString getStatus() const;
+	QString getResult(int digits) const;
+
+	// Asynchronous status: requestStatus() hands a snapshot to the preview
+	// worker, whose results reach the handler on the worker thread.
+	// takeStatus() turns one into the status text while it is current.
+	void setStatusHandler(PreviewWorker::callback_t handler);
+	void requestStatus();
+	std::optional<QString> takeStatus(const PreviewWorker::Result& res) const;
 
     void setPosition(int pos);
 	void setStatusMetrics(QFontMetrics&& fm);
@@ -26,6 +39,7 @@ public:
     QString onEval();
 
 private:
+	QString buildStatus(calculator::status_type st, calculator::op_ptr op, QString body, QString res) const;
 	QString buildExpressionHint(QString body, QString res) const;
 
 private:
@@ -33,8 +47,7 @@ private:
 		OperationComplementer,
 		BinaryOperationSpaceComplementer,
 		UnaryOperationLeftBracketComplementer,
-        MinusComplementer,
-		NumberGapFormatter
+        MinusComplementer
 	>;
 
 	using EvalFormatter = Formatter<Expression,
@@ -43,13 +56,15 @@ private:
 		BinaryOperationSpaceComplementer,
 		UnaryOperationLeftBracketComplementer,
 		MinusComplementer,
-		NumberGapFormatter,
 		RightBracketComplementer
 	>;
 
 private:
-	QFontMetrics statusMetrics_{ QFont{} };
+	mutable GlyphAdvances statusAdvances_{ QFontMetrics{ QFont{} } };
 	int statusWidth_;
 
 	Expression expr_;
+	mutable std::optional<calculator::digit_expansion> expansion_;
+	mutable std::uint64_t expansionRevision_{ 0 };
+	PreviewWorker preview_;
 };
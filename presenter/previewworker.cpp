@@ -0,0 +1,93 @@
+#include <array>
+#include "previewworker.hpp"
+#include "proxylexer.hpp"
+#include "evalview.hpp"
+
+PreviewWorker::PreviewWorker() : 
+    thread_{ [this]() { loop(); } }
+{ }
+
+void PreviewWorker::setCallback(callback_t callback) {
+    std::lock_guard lock{ callback_mutex_ };
+    callback_ = std::move(callback);
+}
+
+void PreviewWorker::submit(std::uint64_t revision, TokenTable tokens) {
+    {
+        std::lock_guard lock{ mutex_ };
+        latest_ = revision;
+        cancel_ = true;
+        pending_ = Job{ revision, std::move(tokens) };
+    }
+    cv_.notify_one();
+}
+
+PreviewWorker::~PreviewWorker() {
+    {
+        std::lock_guard lock{ mutex_ };
+        stop_ = true;
+        cancel_ = true;
+        pending_.reset();
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+void PreviewWorker::loop() {
+    while (true) {
+        std::optional<Job> job;
+        {
+            std::unique_lock lock{ mutex_ };
+            cv_.wait(lock, [this]() { return stop_ || pending_; });
+            if (stop_)
+                return;
+            job = std::move(pending_);
+            pending_.reset();
+            cancel_ = false;
+        }
+
+        auto res = compute(*job);
+        if (!res)
+            continue;
+
+        std::lock_guard lock{ callback_mutex_ };
+        if (callback_ && !superseded(res->revision))
+            callback_(std::move(*res));
+    }
+}
+
+// Parses and evaluates the snapshot and renders the texts of the status;
+// fitting them to the status bar and translating errors is left to
+// Presenter::takeStatus().
+std::optional<PreviewWorker::Result> PreviewWorker::compute(const Job& job) {
+    Result res{ job.revision, calculator::status_type::OK, nullptr, {}, {} };
+
+    auto [tree, st] = calculator::parse(ProxyLexer{ job.tokens });
+    if (superseded(job.revision))
+        return std::nullopt;
+
+    res.status = st;
+    if (st != calculator::status_type::PARTLY_INVALID_EXPR)
+        return res;
+
+    auto [value, est, op] = calculator::eval(tree, eval_cache_, Settings::precision, &cancel_);
+    if (est == calculator::status_type::CANCELLED || superseded(job.revision))
+        return std::nullopt;
+
+    res.status = est;
+    res.op = op;
+    if (est != calculator::status_type::OK)
+        return res;
+
+    std::array<BlockPtr, 1> result{ BlockPtr{ new Number(0, value) } };
+    TokenTable result_tokens;
+    result_tokens.assign(result.begin(), result.end());
+
+    res.body = EvalView{ job.tokens }.toString();
+    res.value = EvalView{ result_tokens }.toString();
+    return res;
+}
+
+bool PreviewWorker::superseded(std::uint64_t revision) const noexcept {
+    return latest_ != revision;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <optional>
+#include <functional>
+#include <condition_variable>
+#include <QString>
+#include "model/parser.hpp"
+#include "model/eval.hpp"
+#include "settings.hpp"
+#include "tokentable.hpp"
+
+// Evaluates snapshots of an expression for the status preview on a thread
+// of its own. Only the newest snapshot waits: a later submit replaces it
+// and cancels the running computation, whose evaluation stops at its next
+// step without a result. Results are handed to the callback on the worker
+// thread.
+class PreviewWorker {
+public:
+    struct Result {
+        std::uint64_t revision;
+        calculator::status_type status;
+        calculator::op_ptr op;
+        // texts of the expression and its value as EvalView shows them
+        QString body;
+        QString value;
+    };
+
+    using callback_t = std::function<void(Result)>;
+
+public:
+    PreviewWorker();
+    PreviewWorker(const PreviewWorker&) = delete;
+    PreviewWorker& operator=(const PreviewWorker&) = delete;
+
+    void setCallback(callback_t callback);
+    void submit(std::uint64_t revision, TokenTable tokens);
+
+    ~PreviewWorker();
+
+private:
+    struct Job {
+        std::uint64_t revision;
+        TokenTable tokens;
+    };
+
+    void loop();
+    std::optional<Result> compute(const Job& job);
+    bool superseded(std::uint64_t revision) const noexcept;
+
+private:
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::optional<Job> pending_;
+    bool stop_{ false };
+    std::atomic<std::uint64_t> latest_{ 0 };
+    // set by a submit while a computation runs
+    calculator::cancel_token cancel_{ false };
+
+    std::mutex callback_mutex_;
+    callback_t callback_;
+
+    calculator::eval_cache eval_cache_;
+    std::thread thread_;
+};
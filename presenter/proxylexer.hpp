@@ -1,52 +1,27 @@
 #pragma once
 
-#include <list>
 #include "model/token.hpp"
-#include "model/lexer.hpp"
-#include "settings.hpp"
-#include "elements.hpp"
+#include "tokentable.hpp"
 
-template<typename Iter>
 class ProxyLexer {
 public:
 	ProxyLexer() = delete;
 
-    template<class ExprT>
-    ProxyLexer(ExprT &expr) : current_{expr.begin()}, end_{expr.end()}
+    ProxyLexer(const TokenTable &tokens) : tokens_{ tokens }, end_{ tokens.count() }
 	{ }
 
 	calculator::token_t get_token() {
-        while (current_ != end_ && is_empty())
-			current_ = std::next(current_);
+        auto& types = tokens_.types();
+        while (current_ != end_ && types[current_] == calculator::token_type::EMPTY)
+			++current_;
 
 		if (current_ == end_)
 			return calculator::empty_token;
 
-		auto& cur = *current_;
-		current_ = std::next(current_);
-
-		if (cur->type() == calculator::token_type::NUMBER) {
-			auto ptr = static_cast<Number*>(cur.get());
-            if (!ptr->isMutable())
-				return calculator::token_t {
-					calculator::token_type::NUMBER,
-					calculator::status_type::OK,
-					ptr->get()
-				};
-		}
-
-		calculator::lexer lex(cur->toString(false).toStdWString(), Settings::max_output_size);
-        return lex.get_token();
-	}
-
-private:
-	bool is_empty() const noexcept {
-		return (*current_)->type() == calculator::token_type::EMPTY;
+		return tokens_.token(current_++);
 	}
 
 private:
-    Iter current_, end_;
+    const TokenTable &tokens_;
+    int current_{ 0 }, end_;
 };
-
-template<class ExprT>
-ProxyLexer(ExprT &expr) -> ProxyLexer<decltype(std::declval<ExprT>().begin())>;
\ No newline at end of file
@@ -3,4 +3,6 @@
 struct Settings {
 	static constexpr int max_output_size = 15;
 	static constexpr int precision = 1 << 10;
+	// inserted texts from this size on are lexed in one pass
+	static constexpr int bulk_insert_size = 64;
 };
\ No newline at end of file
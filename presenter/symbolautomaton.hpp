@@ -0,0 +1,196 @@
+#pragma once
+
+#include <map>
+#include <deque>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <algorithm>
+#include <string_view>
+#include "model/token.hpp"
+
+// Minimal deterministic automaton over a set of symbols. States equal in
+// what they accept after them are merged, the transitions of all of them
+// lie in one table indexed by state and character class. Reading a
+// symbol keeps a Run, so one more character is one more transition.
+class SymbolAutomaton {
+public:
+    using state_t = std::uint16_t;
+
+    static constexpr state_t kStart = 0;
+
+    // Result of reading a text from the start: the state after its longest
+    // readable prefix, the prefix length, the type of the first symbol on
+    // the way and whether a character had no transition. A dead run reads
+    // nothing more.
+    struct Run {
+        state_t state{ kStart };
+        int matched{ 0 };
+        calculator::symbol_type type{ calculator::symbol_type::UNKNOWN };
+        bool dead{ false };
+    };
+
+public:
+    SymbolAutomaton() = delete;
+
+    template<
+        std::forward_iterator ForwIt,
+        typename = std::enable_if_t<std::is_same_v<
+            std::pair<std::wstring, calculator::symbol_type>,
+            typename std::iterator_traits<ForwIt>::value_type
+        >>
+    >
+    SymbolAutomaton(ForwIt begin, ForwIt end) {
+        build(minimize(begin, end));
+    }
+
+    Run feed(Run run, std::wstring_view str) const noexcept {
+        for (auto ch : str) {
+            if (run.dead)
+                break;
+
+            auto next = transition(run.state, ch);
+            if (next == kDead) {
+                run.dead = true;
+                break;
+            }
+
+            run.state = next;
+            ++run.matched;
+            if (run.type == calculator::symbol_type::UNKNOWN)
+                run.type = accepts_[next];
+        }
+        return run;
+    }
+
+    Run run(std::wstring_view str) const noexcept {
+        return feed(Run{}, str);
+    }
+
+    calculator::symbol_type accepts(state_t state) const noexcept {
+        return accepts_[state];
+    }
+
+    // Characters that lead from the state to a symbol while it is the only
+    // way on, empty at a symbol or at a fork.
+    std::wstring_view completion(state_t state) const noexcept {
+        return std::wstring_view{ completions_ }.substr(
+            completion_starts_[state],
+            completion_starts_[state + 1] - completion_starts_[state]
+        );
+    }
+
+private:
+    static constexpr state_t kDead = std::numeric_limits<state_t>::max();
+
+    struct State {
+        calculator::symbol_type type;
+        std::map<wchar_t, size_t> edges;
+
+        auto operator<=>(const State&) const = default;
+    };
+
+    // Builds the trie of the symbols and merges equal states bottom-up, so
+    // that a state is registered only after everything it leads to.
+    // Returns the distinct states, the start one last.
+    template<class ForwIt>
+    static std::vector<State> minimize(ForwIt begin, ForwIt end) {
+        std::vector<State> trie{ State{ calculator::symbol_type::UNKNOWN, {} } };
+        for (; begin != end; ++begin) {
+            size_t node{ 0 };
+            for (auto ch : begin->first) {
+                auto it = trie[node].edges.find(ch);
+                if (it == trie[node].edges.end()) {
+                    it = trie[node].edges.insert({ ch, trie.size() }).first;
+                    trie.push_back(State{ calculator::symbol_type::UNKNOWN, {} });
+                }
+                node = it->second;
+            }
+            trie[node].type = begin->second;
+        }
+
+        std::vector<State> states;
+        std::map<State, size_t> registry;
+        auto reg = [&](auto& self, size_t node) -> size_t {
+            State st{ trie[node].type, {} };
+            for (auto& [ch, next] : trie[node].edges)
+                st.edges.insert({ ch, self(self, next) });
+
+            auto [it, added] = registry.insert({ st, states.size() });
+            if (added)
+                states.push_back(std::move(st));
+            return it->second;
+        };
+        reg(reg, 0);
+
+        return states;
+    }
+
+    // Numbers the states breadth-first from the start one and lays out the
+    // transition table and the completions.
+    void build(const std::vector<State>& states) {
+        for (auto& st : states)
+            for (auto& edge : st.edges)
+                classes_.push_back(edge.first);
+        std::sort(classes_.begin(), classes_.end());
+        classes_.erase(std::unique(classes_.begin(), classes_.end()), classes_.end());
+
+        std::vector<state_t> ids(states.size(), kDead);
+        std::vector<size_t> order;
+        std::deque<size_t> queue{ states.size() - 1 };
+        ids.back() = kStart;
+        while (!queue.empty()) {
+            auto cur = queue.front();
+            queue.pop_front();
+            order.push_back(cur);
+            for (auto& edge : states[cur].edges) {
+                if (ids[edge.second] != kDead)
+                    continue;
+                ids[edge.second] = static_cast<state_t>(order.size() + queue.size());
+                queue.push_back(edge.second);
+            }
+        }
+
+        transitions_.assign(order.size() * classes_.size(), kDead);
+        for (auto cur : order) {
+            accepts_.push_back(states[cur].type);
+            for (auto& [ch, next] : states[cur].edges)
+                transitions_[ids[cur] * classes_.size() + charClass(ch)] = ids[next];
+        }
+
+        for (auto cur : order) {
+            completion_starts_.push_back(completions_.size());
+            auto st = &states[cur];
+            while (st->type == calculator::symbol_type::UNKNOWN && st->edges.size() == 1) {
+                completions_.push_back(st->edges.begin()->first);
+                st = &states[st->edges.begin()->second];
+            }
+        }
+        completion_starts_.push_back(completions_.size());
+    }
+
+    size_t charClass(wchar_t ch) const noexcept {
+        auto it = std::lower_bound(classes_.begin(), classes_.end(), ch);
+        return (it != classes_.end() && *it == ch)
+            ? static_cast<size_t>(it - classes_.begin())
+            : classes_.size();
+    }
+
+    state_t transition(state_t state, wchar_t ch) const noexcept {
+        auto cls = charClass(ch);
+        return (cls != classes_.size())
+            ? transitions_[state * classes_.size() + cls]
+            : kDead;
+    }
+
+private:
+    std::vector<wchar_t> classes_;
+    std::vector<state_t> transitions_;
+    std::vector<calculator::symbol_type> accepts_;
+    std::wstring completions_;
+    std::vector<size_t> completion_starts_;
+};
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <algorithm>
+#include <QString>
+
+// Replacement turning one text into another: the removed characters from
+// start on give way to the inserted ones. Texts are compared from both
+// ends, so an edit in one place yields just that place.
+struct TextDiff {
+    int start;
+    int removed;
+    QString inserted;
+
+    bool empty() const noexcept {
+        return !removed && inserted.isEmpty();
+    }
+
+    static TextDiff between(const QString& from, const QString& to) {
+        auto limit = std::min(from.size(), to.size());
+        auto head = static_cast<int>(
+            std::mismatch(from.begin(), from.begin() + limit, to.begin()).first - from.begin()
+        );
+        auto tail = static_cast<int>(
+            std::mismatch(from.rbegin(), from.rend() - head, to.rbegin(), to.rend() - head).first - from.rbegin()
+        );
+        return { head, from.size() - head - tail, to.mid(head, to.size() - head - tail) };
+    }
+};
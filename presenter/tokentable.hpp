@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <memory>
+#include <vector>
+#include <string_view>
+#include "model/token.hpp"
+#include "elements.hpp"
+
+// Flat snapshot of an expression for the readers that go through all of
+// its blocks in order: the stored text in one buffer and one array per
+// block attribute, all indexed by block number. Tokens are the ones cached
+// by the blocks. The expression itself is edited in its block tree.
+class TokenTable {
+public:
+    template<class Iter>
+    void assign(Iter begin, Iter end) {
+        clear();
+        for (auto it = begin; it != end; ++it)
+            append(**it);
+    }
+
+    void clear() {
+        plain_.clear();
+        types_.clear();
+        plain_starts_.clear();
+        plain_lengths_.clear();
+        symbol_types_.clear();
+        tokens_.clear();
+    }
+
+    int count() const noexcept {
+        return static_cast<int>(types_.size());
+    }
+
+    calculator::token_type type(int id) const noexcept {
+        return types_[id];
+    }
+
+    std::wstring_view plain(int id) const noexcept {
+        return std::wstring_view{ plain_ }.substr(plain_starts_[id], plain_lengths_[id]);
+    }
+
+    calculator::symbol_type symbolType(int id) const noexcept {
+        return symbol_types_[id];
+    }
+
+    const calculator::token_t& token(int id) const noexcept {
+        return *tokens_[id];
+    }
+
+    const std::vector<calculator::token_type>& types() const noexcept {
+        return types_;
+    }
+
+private:
+    void append(const Block& bl) {
+        auto type = bl.type();
+        auto plain = bl.toString(false).toStdWString();
+
+        types_.push_back(type);
+        plain_starts_.push_back(static_cast<int>(plain_.size()));
+        plain_lengths_.push_back(static_cast<int>(plain.size()));
+        symbol_types_.push_back(
+            (type == calculator::token_type::SYMBOL)
+                ? static_cast<const Symbol&>(bl).symbol_type()
+                : calculator::symbol_type::UNKNOWN
+        );
+
+        tokens_.push_back((type != calculator::token_type::EMPTY) ? bl.token() : nullptr);
+
+        plain_.append(plain);
+    }
+
+private:
+    std::wstring plain_;
+    std::vector<calculator::token_type> types_;
+    std::vector<int> plain_starts_;
+    std::vector<int> plain_lengths_;
+    std::vector<calculator::symbol_type> symbol_types_;
+    std::vector<std::shared_ptr<const calculator::token_t>> tokens_;
+};
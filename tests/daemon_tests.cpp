@@ -0,0 +1,105 @@
+#include <string>
+#include <iostream>
+#include "daemon/json.hpp"
+#include "daemon/server.hpp"
+
+namespace {
+
+using namespace calcd;
+
+int failures = 0;
+
+void expect(bool cond, const std::string& what) {
+    if (cond)
+        return;
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+}
+
+void expectResponse(std::string_view request, const std::string& response) {
+    auto res = server::handle(request);
+    expect(res == response, std::string{ request } + " gives " + response + ", not " + res);
+}
+
+// Strings are unescaped, numbers and literals keep their text and the last
+// of repeated keys wins.
+void parsesScalarMembers() {
+    auto obj = parse_object(R"( { "s" : "a\"b\\c\/\n\u00e9\ud83d\ude00", "n": -12.5e+3, "t": true, "z": null, "s2": "", "n": 7 } )");
+    expect(obj.has_value(), "a flat object parses");
+    if (!obj)
+        return;
+
+    expect(obj->size() == 5, "repeated keys are kept once");
+    expect(obj->at("s").kind == json_value::kind_type::STRING && obj->at("s").text == "a\"b\\c/\n\xC3\xA9\xF0\x9F\x98\x80", "escapes are unescaped to UTF-8");
+    expect(obj->at("n").kind == json_value::kind_type::NUMBER && obj->at("n").text == "7", "the last repeated key wins");
+    expect(obj->at("t").kind == json_value::kind_type::LITERAL && obj->at("t").text == "true", "literals keep their text");
+    expect(obj->at("z").kind == json_value::kind_type::LITERAL && obj->at("z").text == "null", "null is a literal");
+    expect(obj->at("s2").text.empty(), "empty strings parse");
+    expect(parse_object("{}").has_value(), "an empty object parses");
+}
+
+void rejectsMalformedText() {
+    for (auto text : {
+        "",
+        "[]",
+        "{",
+        "{\"a\":1",
+        "{\"a\":1,}",
+        "{\"a\" 1}",
+        "{a:1}",
+        "{\"a\":1} x",
+        "{\"a\":{\"b\":1}}",
+        "{\"a\":[1]}",
+        "{\"a\":01x}",
+        "{\"a\":1.}",
+        "{\"a\":tru}",
+        "{\"a\":\"\\q\"}",
+        "{\"a\":\"\\u12\"}",
+        "{\"a\":\"\\udc00\"}",
+        "{\"a\":\"\\ud83d\"}",
+        "{\"a\":\"tab\there\"}",
+        "{\"a\":\"open}"
+    }) {
+        expect(!parse_object(text).has_value(), std::string{ "rejects " } + text);
+    }
+}
+
+// Responses carry the request's id as it was written, or null.
+void echoesIds() {
+    expectResponse(R"({"id":7,"expr":"1 + 2"})", R"({"id":7,"status":"OK","result":"3"})");
+    expectResponse(R"({"expr":"1 + 2","id":"a\"b"})", R"({"id":"a\"b","status":"OK","result":"3"})");
+    expectResponse(R"({"id":-1.5e2,"expr":"2 x 3"})", R"({"id":-1.5e2,"status":"OK","result":"6"})");
+    expectResponse(R"({"id":null,"expr":"1"})", R"({"id":null,"status":"OK","result":"1"})");
+    expectResponse(R"({"expr":"1"})", R"({"id":null,"status":"OK","result":"1"})");
+}
+
+void evaluatesRequests() {
+    expectResponse(R"({"id":1,"expr":"1 / 3","digits":5})", R"({"id":1,"status":"OK","result":"0.33333"})");
+    expectResponse(R"j({"id":2,"expr":"sqrt(-1)"})j", R"({"id":2,"status":"INVALID_ARGUMENT","op":"SQRT"})");
+    expectResponse(R"({"id":3,"expr":"2 +"})", R"({"id":3,"status":"INVALID_EVAL","op":"ADD"})");
+    expectResponse(R"({"id":4,"expr":"foo"})", R"({"id":4,"status":"UNKNOWN_SYMBOL"})");
+    expectResponse(R"({"id":5,"expr":"\u03c0","digits":3,"precision":64})", R"({"id":5,"status":"OK","result":"3.14"})");
+}
+
+void reportsInvalidRequests() {
+    expectResponse("not json", R"({"id":null,"error":"malformed request"})");
+    expectResponse(R"({"id":1,"expr":{"a":1}})", R"({"id":null,"error":"malformed request"})");
+    expectResponse(R"({"id":1})", R"({"id":1,"error":"\"expr\" must be a string"})");
+    expectResponse(R"({"id":1,"expr":12})", R"({"id":1,"error":"\"expr\" must be a string"})");
+    expectResponse(R"({"id":1,"expr":"1","precision":1})", R"({"id":1,"error":"\"precision\" must be an integer in [2, 1048576]"})");
+    expectResponse(R"({"id":1,"expr":"1","precision":"64"})", R"({"id":1,"error":"\"precision\" must be an integer in [2, 1048576]"})");
+    expectResponse(R"({"id":1,"expr":"1","precision":64.5})", R"({"id":1,"error":"\"precision\" must be an integer in [2, 1048576]"})");
+    expectResponse(R"({"id":1,"expr":"1","digits":0})", R"({"id":1,"error":"\"digits\" must be an integer in [1, 65536]"})");
+    expectResponse(R"({"id":1,"expr":"1","digits":65537})", R"({"id":1,"error":"\"digits\" must be an integer in [1, 65536]"})");
+}
+
+} // namespace
+
+int main() {
+    parsesScalarMembers();
+    rejectsMalformedText();
+    echoesIds();
+    evaluatesRequests();
+    reportsInvalidRequests();
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,434 @@
+#include <mutex>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <thread>
+#include <condition_variable>
+#include "presenter/expression.hpp"
+#include "presenter/formatters.hpp"
+#include "presenter/evalview.hpp"
+#include "presenter/previewworker.hpp"
+
+namespace {
+
+using StableFormatter = Formatter<Expression,
+    OperationComplementer,
+    BinaryOperationSpaceComplementer,
+    UnaryOperationLeftBracketComplementer,
+    MinusComplementer
+>;
+
+using EvalFormatter = Formatter<Expression,
+    Reformatter,
+    OperationComplementer,
+    BinaryOperationSpaceComplementer,
+    UnaryOperationLeftBracketComplementer,
+    MinusComplementer,
+    RightBracketComplementer
+>;
+
+// The formatters of a pipeline one after another, each as a traversal
+// of its own followed by its batch of edits.
+template<template<class, class> class... Formatters>
+struct Sequential {
+    static void apply(Expression& expr, Expression::ContainerType& cont) {
+        (Formatter<Expression, Formatters>::traverse(expr, cont), ...);
+        expr.markFormatted();
+    }
+};
+
+using SequentialStableFormatter = Sequential<
+    OperationComplementer,
+    BinaryOperationSpaceComplementer,
+    UnaryOperationLeftBracketComplementer,
+    MinusComplementer
+>;
+
+using SequentialEvalFormatter = Sequential<
+    Reformatter,
+    OperationComplementer,
+    BinaryOperationSpaceComplementer,
+    UnaryOperationLeftBracketComplementer,
+    MinusComplementer,
+    RightBracketComplementer
+>;
+
+int failures = 0;
+
+void expect(bool cond, const std::string& what) {
+    if (cond)
+        return;
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+}
+
+std::string layout(const Expression& expr) {
+    std::string out;
+    for (auto& bl : expr)
+        out += std::to_string(bl->begin()) + ":" + bl->toString(false).toStdString() + " ";
+    return out;
+}
+
+// Blocks follow each other without gaps, the bracket count is the one of
+// the blocks and the cursor lies within the text.
+bool isConsistent(const Expression& expr) {
+    auto pos{ 0 }, open{ 0 };
+    for (auto& bl : expr) {
+        if (bl->begin() != pos)
+            return false;
+        pos = bl->end();
+        open += bl->type() == calculator::token_type::LBRACKET;
+        open -= bl->type() == calculator::token_type::RBRACKET;
+    }
+    return open == expr.getOpenBracketsCount() && expr.getPosition() <= pos;
+}
+
+// Positions map between the stored and the shown text as the shown text
+// of the blocks, walked from the first one, has them.
+bool isShownMappingCurrent(const Expression& expr) {
+    QString shown;
+    for (auto& bl : expr) {
+        auto text = bl->toString(false);
+        auto integer_sz = (bl->type() == calculator::token_type::NUMBER)
+            ? NumberGaps::integerSize(text.toStdWString())
+            : 0;
+        for (auto pos = 0; pos < bl->size(); ++pos) {
+            auto at = shown.size() + NumberGaps::toShown(integer_sz, pos);
+            if (expr.toShown(bl->begin() + pos) != at || expr.fromShown(at) != bl->begin() + pos)
+                return false;
+        }
+        shown.append(bl->toString());
+    }
+    return shown == expr.getExpression() && 
+        expr.toShown(expr.size()) == shown.size() &&
+        expr.fromShown(shown.size()) == expr.size();
+}
+
+// The view of the table shows what EvalFormatter makes of the expression.
+bool isViewFormatted(const Expression& expr) {
+    Expression formatted{ expr };
+    formatted.update<EvalFormatter>();
+
+    return EvalView{ expr.tokens() }.toString() == formatted.getExpression();
+}
+
+void removalMergingNeighboursKeepsStarts() {
+    Expression expr;
+    expr.insert("1+2 x 5");
+    expr.update();
+    expr.removeRange({{ 1, 1 }});
+    expr.update();
+
+    expect(expr.getExpression() == "12 x 5", "removal merges the numbers around it");
+    expect(isConsistent(expr), "blocks after a merging removal keep their starts: " + layout(expr));
+}
+
+void reformattingKeepsStarts() {
+    Expression expr;
+    expr.insert("1 +  2 x  (3");
+    expr.update<StableFormatter>();
+    expr.update<EvalFormatter>();
+
+    expect(isConsistent(expr), "blocks keep their starts when spaces are dropped: " + layout(expr));
+}
+
+void bulkInsertNextToBracket() {
+    Expression expr;
+    expr.insert("(1)");
+    expr.update();
+    expr.setPosition(1);
+    expr.insertBulk("2+");
+    expr.update();
+
+    expect(expr.getExpression() == "(2+1)", "bulk text goes in at the cursor");
+    expect(isConsistent(expr), "blocks after a bulk insertion are shifted: " + layout(expr));
+}
+
+void insertionSplittingLastBlock() {
+    Expression expr;
+    expr.insert("(^");
+    expr.update();
+    expr.setPosition(1);
+    expr.insert("sqrt1");
+    expr.update<StableFormatter>();
+
+    expect(expr.getExpression() == "(sqrt(1 ^ ", "the operator after the insertion gets its spaces: " + layout(expr));
+    expect(expr.getPosition() == 8, "the cursor goes past the inserted text");
+}
+
+// Every range is given in the text before the edit, also after an earlier
+// one took a whole result number with it.
+void multiRangeEditsUseOriginalPositions() {
+    Expression expr;
+    expr.insert("1/3");
+    expr.update<EvalFormatter>();
+    expr.evalAndUpdate();
+    expr.insert("-2");
+    expr.update<StableFormatter>();
+    expr.removeRange({{ 3, 1 }, { 20, 1 }});
+    expr.update();
+
+    expect(expr.getExpression() == " - ", "the number goes as a whole and the last digit with it: " + layout(expr));
+    expect(isConsistent(expr), "blocks after removed ranges keep their starts: " + layout(expr));
+
+    Expression inserted;
+    inserted.insert("12 + 3");
+    inserted.update();
+    inserted.insertRange({{ 6, "4" }, { 0, "5" }, { 1, "x" }});
+    inserted.update();
+
+    expect(inserted.getExpression() == "51x2 + 34", "every text goes in at its position: " + layout(inserted));
+    expect(inserted.getPosition() == 9, "the cursor moves past the texts before it");
+    expect(isConsistent(inserted), "blocks after inserted ranges keep their starts: " + layout(inserted));
+}
+
+// Formats the edited blocks, or every block when full is set.
+template<class F>
+void format(Expression& expr, bool full) {
+    if (full)
+        expr.markAllDirty();
+    expr.update<F>();
+}
+
+// One edit in the way the presenter makes them, followed by its formatting.
+// Expressions with the same text and cursor take the same edit from
+// generators in the same state.
+template<class Stable = StableFormatter, class Eval = EvalFormatter>
+void randomEdit(std::mt19937& rng, Expression& expr, bool full = false) {
+    static const std::vector<std::string> pieces{
+        "1", "0", ".", "12", "3.5", "e5", "1000000", "+", "-", "x", "/", "^", "!", "%",
+        "(", ")", " ", "sin", "cos", "s", "in", "lg", "ln", "PI", "E", "sqrt"
+    };
+
+    auto action = rng() % 100;
+    if (action < 45) {
+        std::string text;
+        for (auto n = rng() % 3 + 1; n > 0; --n)
+            text += pieces[rng() % pieces.size()];
+        if (rng() % 10 == 0)
+            expr.insertBulk(text.c_str());
+        else
+            expr.insert(text.c_str());
+        format<Stable>(expr, full);
+    }
+    else if (action < 70) {
+        auto cursor = expr.getPosition();
+        auto count = static_cast<int>(rng() % 4) + 1;
+        auto from = std::max(0, cursor - count * static_cast<int>(rng() % 2));
+        auto to = std::min(expr.size(), from + count);
+        if (from < to)
+            expr.removeRange({{ from, to - from }});
+        format<Stable>(expr, full);
+    }
+    else if (action < 85) {
+        expr.setPosition(static_cast<int>(rng() % (expr.size() + 1)));
+    }
+    else if (action < 93) {
+        expr.pushFront("1/(").pushBack(")");
+        format<Stable>(expr, full);
+    }
+    else if (action < 98) {
+        format<Eval>(expr, full);
+        expr.evalAndUpdate();
+        format<Stable>(expr, full);
+    }
+    else {
+        expr.clear();
+        expr.update();
+    }
+}
+
+void randomEditsKeepLayout() {
+    for (unsigned seed = 0; seed < 50; ++seed) {
+        std::mt19937 rng{ seed };
+        Expression expr;
+        expr.update<StableFormatter>();
+        for (int step = 0; step < 300; ++step) {
+            randomEdit(rng, expr);
+            if (!isConsistent(expr) || !isShownMappingCurrent(expr) || !isViewFormatted(expr)) {
+                expect(false, "seed " + std::to_string(seed) + ", step " + std::to_string(step) + ": " + layout(expr));
+                return;
+            }
+        }
+    }
+}
+
+// Formatting only the edited blocks gives the text and cursor that
+// formatting every block gives.
+void dirtyFormattingMatchesFull() {
+    for (unsigned seed = 0; seed < 100; ++seed) {
+        std::mt19937 dirty_rng{ seed }, full_rng{ seed };
+        Expression dirty, full;
+        dirty.update<StableFormatter>();
+        format<StableFormatter>(full, true);
+        for (int step = 0; step < 300; ++step) {
+            randomEdit(dirty_rng, dirty);
+            randomEdit(full_rng, full, true);
+            if (dirty.getExpression() != full.getExpression() || dirty.getPosition() != full.getPosition()) {
+                expect(false, "seed " + std::to_string(seed) + ", step " + std::to_string(step) + ": " + 
+                    layout(dirty) + " formatted whole is " + layout(full));
+                return;
+            }
+        }
+    }
+}
+
+std::string flagsOf(const Expression& expr) {
+    std::string out;
+    for (auto& bl : expr)
+        out += bl->formatFlags().to_string() + " ";
+    return out;
+}
+
+// The formatters fused into one traversal leave the text, cursor, blocks
+// and flags that running them one after another leaves.
+void fusedFormattingMatchesSequential() {
+    for (unsigned seed = 0; seed < 100; ++seed) {
+        std::mt19937 fused_rng{ seed }, sequential_rng{ seed };
+        Expression fused, sequential;
+        fused.update<StableFormatter>();
+        sequential.update<SequentialStableFormatter>();
+        for (int step = 0; step < 300; ++step) {
+            randomEdit(fused_rng, fused);
+            randomEdit<SequentialStableFormatter, SequentialEvalFormatter>(sequential_rng, sequential);
+            if (layout(fused) != layout(sequential) || fused.getPosition() != sequential.getPosition() ||
+                flagsOf(fused) != flagsOf(sequential)) {
+                expect(false, "seed " + std::to_string(seed) + ", step " + std::to_string(step) + ": " +
+                    layout(fused) + " formatted in passes is " + layout(sequential));
+                return;
+            }
+        }
+    }
+}
+
+TokenTable tokensOf(const std::string& text) {
+    Expression expr;
+    expr.insertBulk(text.c_str());
+    expr.update<EvalFormatter>();
+    return expr.tokens();
+}
+
+// Collects what a preview worker delivers; the first delivery can be held
+// until release() so that submits pile up behind it.
+struct PreviewLog {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<PreviewWorker::Result> results;
+    bool holdFirst{ false };
+    bool released{ false };
+
+    PreviewWorker::callback_t callback() {
+        return [this](PreviewWorker::Result res) {
+            std::unique_lock lock{ mutex };
+            results.push_back(std::move(res));
+            cv.notify_all();
+            if (holdFirst && results.size() == 1)
+                cv.wait(lock, [this]() { return released; });
+        };
+    }
+
+    bool waitFor(std::uint64_t revision, std::chrono::milliseconds timeout = std::chrono::seconds{ 30 }) {
+        std::unique_lock lock{ mutex };
+        return cv.wait_for(lock, timeout, [&]() { 
+            return !results.empty() && results.back().revision == revision; 
+        });
+    }
+
+    void release() {
+        std::lock_guard lock{ mutex };
+        released = true;
+        cv.notify_all();
+    }
+};
+
+void previewDeliversResult() {
+    PreviewLog log;
+    PreviewWorker worker;
+    worker.setCallback(log.callback());
+
+    worker.submit(1, tokensOf("1+2x3"));
+    expect(log.waitFor(1), "the preview of a submitted expression arrives");
+    worker.submit(2, tokensOf("sqrt(-1)"));
+    expect(log.waitFor(2), "the preview of a failing expression arrives");
+
+    std::lock_guard lock{ log.mutex };
+    expect(log.results.size() == 2, "every preview arrives once");
+    if (log.results.size() != 2)
+        return;
+    expect(log.results[0].status == calculator::status_type::OK && log.results[0].value == "7", "the preview carries the value");
+    expect(log.results[0].body == EvalView{ tokensOf("1+2x3") }.toString(), "the preview carries the expression as EvalView shows it");
+    expect(log.results[1].status == calculator::status_type::INVALID_ARGUMENT, "the preview carries the failure");
+    expect(log.results[1].op && log.results[1].op->type() == calculator::symbol_type::SQRT, "the preview carries the failed operation");
+}
+
+// Only the newest of the snapshots submitted while the worker is busy is
+// computed.
+void previewSkipsSupersededSnapshots() {
+    PreviewLog log;
+    log.holdFirst = true;
+    PreviewWorker worker;
+    worker.setCallback(log.callback());
+
+    worker.submit(1, tokensOf("1"));
+    {
+        std::unique_lock lock{ log.mutex };
+        log.cv.wait(lock, [&]() { return !log.results.empty(); });
+    }
+    for (std::uint64_t revision = 2; revision <= 20; ++revision)
+        worker.submit(revision, tokensOf(std::to_string(revision)));
+    log.release();
+
+    expect(log.waitFor(20), "the newest snapshot is computed");
+    std::lock_guard lock{ log.mutex };
+    expect(log.results.size() == 2, "the snapshots between are skipped");
+    expect(log.results.back().value == "20", "the newest snapshot's value arrives");
+}
+
+// A submit cancels the running evaluation, whose result never arrives.
+void previewCancelsRunningEvaluation() {
+    std::string slow;
+    for (auto i = 1; i <= 10000; ++i)
+        slow += (i > 1 ? "+sin(" : "sin(") + std::to_string(i) + ")";
+    auto slowTokens = tokensOf(slow);
+
+    PreviewLog log;
+    PreviewWorker worker;
+    worker.setCallback(log.callback());
+
+    auto begin = std::chrono::steady_clock::now();
+    worker.submit(1, slowTokens);
+    expect(log.waitFor(1, std::chrono::minutes{ 2 }), "the slow expression finishes alone");
+    auto alone = std::chrono::steady_clock::now() - begin;
+
+    // the worker keeps its cache, so the slow expression changes
+    slowTokens = tokensOf(slow + "+1");
+    begin = std::chrono::steady_clock::now();
+    worker.submit(2, slowTokens);
+    std::this_thread::sleep_for(alone / 20);
+    worker.submit(3, tokensOf("2"));
+    expect(log.waitFor(3), "the preview after a cancelled one arrives");
+    auto cancelled = std::chrono::steady_clock::now() - begin;
+
+    std::lock_guard lock{ log.mutex };
+    expect(log.results.size() == 2 && log.results.back().value == "2", "the cancelled evaluation delivers nothing");
+    expect(cancelled < alone / 2, "the cancelled evaluation stops early");
+}
+
+} // namespace
+
+int main() {
+    removalMergingNeighboursKeepsStarts();
+    reformattingKeepsStarts();
+    bulkInsertNextToBracket();
+    insertionSplittingLastBlock();
+    multiRangeEditsUseOriginalPositions();
+    randomEditsKeepLayout();
+    dirtyFormattingMatchesFull();
+    fusedFormattingMatchesSequential();
+    previewDeliversResult();
+    previewSkipsSupersededSnapshots();
+    previewCancelsRunningEvaluation();
+    return failures ? 1 : 0;
+}
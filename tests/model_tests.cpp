@@ -0,0 +1,468 @@
+#include <cmath>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <stack>
+#include <limits>
+#include "model/lexer.hpp"
+#include "model/parser.hpp"
+#include "model/eval.hpp"
+#include "model/batch.hpp"
+#include "model/compiled.hpp"
+#include "model/op_cache.hpp"
+#include "model/digits.hpp"
+
+namespace {
+
+using namespace calculator;
+
+int failures = 0;
+
+void expect(bool cond, const std::string& what) {
+    if (cond)
+        return;
+    std::cerr << "FAILED: " << what << '\n';
+    ++failures;
+}
+
+// Uses the variable where an operand goes and "x" as the multiplication
+// elsewhere, so the same text reads either way.
+std::wstring compiledForm(const std::wstring& v) {
+    return v + L" x " + v + L" + sqrt(" + v + L") / (" + v + L" + 1) - 2 x " + v + L"^2";
+}
+
+void compiledReadsMultiplicationSignAsVariable() {
+    expect(compiled_expr::compile(L"2 x x", { L"x" }).second == status_type::OK, "\"x\" is a valid variable");
+    expect(compiled_expr::compile(L"xy", { L"xy" }).second == status_type::UNKNOWN_SYMBOL, "a name starting with \"x\" is rejected");
+
+    auto [expr, st] = compiled_expr::compile(L"x x x", { L"x" }, 128);
+    std::vector<number_t> xs{ number_t{ 3 } };
+    std::vector<std::span<const number_t>> columns{ xs };
+    std::vector<number_t> out(1);
+    std::vector<status_type> statuses(1);
+    expr.eval(columns, out, statuses);
+    expect(statuses[0] == status_type::OK && out[0] == 9, "\"x x x\" squares the variable");
+}
+
+// Every SIMD width gives the scalar lanes' results bit for bit, the tail
+// of a block included, and they stay close to eval.
+void compiledLanesAgree() {
+    const size_t points = 1003;
+    auto [expr, st] = compiled_expr::compile(compiledForm(L"x"), { L"x" }, 53);
+    expect(st == status_type::OK, "the lanes' expression compiles");
+
+    std::vector<double> xs(points);
+    for (size_t i = 0; i < points; ++i)
+        xs[i] = 0.5 + 0.25 * static_cast<double>(i);
+    std::vector<std::span<const double>> columns{ xs };
+
+    auto widest = compiled_expr::lanes();
+    std::vector<std::vector<double>> outs;
+    for (auto isa : { compiled_expr::lane_isa::SCALAR, compiled_expr::lane_isa::AVX2, compiled_expr::lane_isa::AVX512 }) {
+        if (isa > widest)
+            break;
+
+        compiled_expr::limit_lanes(isa);
+        std::vector<double> out(points);
+        std::vector<status_type> statuses(points);
+        expr.eval(columns, out, statuses);
+        expect(std::all_of(statuses.begin(), statuses.end(), [](auto s) { return s == status_type::OK; }), "every lane succeeds");
+        outs.push_back(std::move(out));
+    }
+    compiled_expr::limit_lanes(widest);
+
+    for (auto& out : outs)
+        expect(out == outs.front(), "SIMD lanes equal the scalar ones");
+
+    for (size_t i = 0; i < points; i += 97) {
+        auto [res, status, op] = eval_one(compiledForm(std::to_wstring(xs[i])), 53);
+        expect(status == status_type::OK, "eval of a lane's point succeeds");
+        expect(std::abs(outs.front()[i] - res.toDouble()) <= 1e-12 * std::abs(res.toDouble()), "double lanes stay close to eval");
+    }
+}
+
+// Above double precision the lanes run the operations eval runs, so their
+// results are the same numbers.
+void compiledMpfrMatchesEval() {
+    const size_t points = 40;
+    const int prec = 160;
+    auto [expr, st] = compiled_expr::compile(compiledForm(L"x"), { L"x" }, prec);
+    expect(st == status_type::OK && !expr.is_native(), "the MPFR expression compiles");
+
+    std::vector<number_t> xs;
+    for (size_t i = 0; i < points; ++i)
+        xs.emplace_back(0.5 + 0.25 * static_cast<double>(i));
+    std::vector<std::span<const number_t>> columns{ xs };
+    std::vector<number_t> out(points);
+    std::vector<status_type> statuses(points);
+    expr.eval(columns, out, statuses);
+
+    for (size_t i = 0; i < points; ++i) {
+        auto [res, status, op] = eval_one(compiledForm(std::to_wstring(xs[i].toDouble())), prec);
+        expect(statuses[i] == status && out[i] == res, "MPFR lane " + std::to_string(i) + " equals eval");
+    }
+}
+
+object_t parsed(const std::wstring& expr, int prec) {
+    std::wistringstream source{ expr };
+    auto [obj, st] = parse(lexer(source, prec / 4));
+    expect(st == status_type::PARTLY_INVALID_EXPR, "the expression parses");
+    return obj;
+}
+
+// Many costly brackets side by side; the ones listed in failing take the
+// square root of a negative number.
+std::wstring wideExpression(size_t width, std::vector<size_t> failing = {}) {
+    std::wstring res;
+    for (size_t i = 0; i < width; ++i) {
+        auto k = std::to_wstring(i + 2);
+        auto sign = std::find(failing.begin(), failing.end(), i) != failing.end() ? L"-" : L"";
+        res += (i ? L" + (" : L"(") + std::wstring{ L"sqrt(" } + sign + k + L") ^ 3 / (" + k + L" + 1) x sqrt(" + k + L" + 1))";
+    }
+    return res;
+}
+
+// Brackets nested inside each other, each with a costly sibling.
+std::wstring deepExpression(size_t depth) {
+    std::wstring res = L"1";
+    for (size_t i = 0; i < depth; ++i) {
+        auto k = std::to_wstring(i + 2);
+        res = L"(sqrt(" + k + L") / (" + res + L") + (sqrt(" + k + L" + 1) ^ 3))";
+    }
+    return res;
+}
+
+void expectSplitMatchesSequential(thread_pool& pool, const std::wstring& expr, int prec, const std::string& what) {
+    auto obj = parsed(expr, prec);
+    auto [num, status, op] = eval(obj, prec);
+    auto [split_num, split_status, split_op] = eval(obj, pool, prec);
+    expect(split_status == status && split_op == op, what + ": the status and failed operation match");
+    if (status == status_type::OK)
+        expect(split_num == num, what + ": the numbers are the same");
+}
+
+void splitEvalMatchesSequential() {
+    const int prec = 1 << 12;
+    thread_pool pool{ 4 };
+    expectSplitMatchesSequential(pool, wideExpression(64), prec, "wide tree");
+    expectSplitMatchesSequential(pool, deepExpression(40), prec, "deep tree");
+    expectSplitMatchesSequential(pool, deepExpression(40) + L" - " + wideExpression(32), prec, "deep and wide tree");
+    expectSplitMatchesSequential(pool, wideExpression(64, { 40 }), prec, "failing bracket");
+    expectSplitMatchesSequential(pool, wideExpression(64, { 20, 50 }), prec, "first of two failing brackets");
+    expectSplitMatchesSequential(pool, wideExpression(4), 64, "tree below the split threshold");
+}
+
+bool sameResult(const std::tuple<number_t, status_type, op_ptr>& a, const std::tuple<number_t, status_type, op_ptr>& b) {
+    auto& [a_num, a_status, a_op] = a;
+    auto& [b_num, b_status, b_op] = b;
+    return a_status == b_status && a_op == b_op && (a_status != status_type::OK || a_num == b_num);
+}
+
+// Every result of a batch is the one eval_one gives for its expression, in
+// input order, whether the batch fits one chunk or spreads over many.
+void batchKeepsOrder() {
+    thread_pool pool{ 3 };
+    const size_t chunked = pool.size() * 8;
+    for (size_t count : { size_t{ 0 }, size_t{ 1 }, chunked - 1, chunked, chunked + 1, size_t{ 1000 } }) {
+        std::vector<std::wstring> exprs;
+        for (size_t i = 0; i < count; ++i)
+            exprs.push_back(std::to_wstring(i) + L" + sqrt(" + std::to_wstring(i % 7) + L")");
+
+        auto results = eval_many(exprs, pool, 128);
+        expect(results.size() == count, "a batch of " + std::to_string(count) + " gives a result for each expression");
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (!sameResult(results[i], eval_one(exprs[i], 128))) {
+                expect(false, "batch result " + std::to_string(i) + " of " + std::to_string(count) + " is its expression's");
+                break;
+            }
+        }
+    }
+}
+
+// A failing expression gives its own status and leaves its neighbours alone.
+void batchReportsErrors() {
+    thread_pool pool{ 3 };
+    std::vector<std::wstring> exprs;
+    for (size_t i = 0; i < 200; ++i) {
+        switch (i % 5)
+        {
+        case 1: exprs.push_back(L"sqrt(-" + std::to_wstring(i) + L")"); break;
+        case 2: exprs.push_back(L"2 +"); break;
+        case 3: exprs.push_back(L"(1 + "); break;
+        default: exprs.push_back(std::to_wstring(i) + L" / 4"); break;
+        }
+    }
+
+    auto results = eval_many(exprs, pool, 64);
+    for (size_t i = 0; i < exprs.size(); ++i) {
+        auto status = std::get<status_type>(results[i]);
+        if (i % 5 == 1 && (status != status_type::INVALID_ARGUMENT || std::get<op_ptr>(results[i])->type() != symbol_type::SQRT))
+            expect(false, "batch item " + std::to_string(i) + " fails in its square root");
+        if ((i % 5 == 2 || i % 5 == 3) && status == status_type::OK)
+            expect(false, "batch item " + std::to_string(i) + " fails as incomplete");
+        if (i % 5 != 1 && i % 5 != 2 && i % 5 != 3 && status != status_type::OK)
+            expect(false, "batch item " + std::to_string(i) + " succeeds next to failing ones");
+        if (!sameResult(results[i], eval_one(exprs[i], 64)))
+            expect(false, "batch item " + std::to_string(i) + " has the status eval_one gives");
+    }
+}
+
+bool cacheIs(size_t hits, size_t misses, size_t size) {
+    auto st = op_cache::stats();
+    return st.hits == hits && st.misses == misses && st.size == size;
+}
+
+number_t sine(const number_t& arg) {
+    return operations().at(symbol_type::SIN)->exec({ arg }).first;
+}
+
+// Repeated arguments hit and give the computed value, a different
+// precision of the same value is another key and the least recently used
+// entry goes first.
+void opCacheHitsAndEvicts() {
+    op_cache::clear();
+    op_cache::set_capacity(2);
+
+    number_t one{ 1, 128 };
+    auto first = sine(one);
+    expect(cacheIs(0, 1, 1), "the first sine is computed");
+    expect(sine(one) == first && first == mpfr::sin(one), "the cached sine is the computed one");
+    expect(cacheIs(1, 1, 1), "the repeated sine hits");
+
+    sine(number_t{ 1, 256 });
+    expect(cacheIs(1, 2, 2), "another precision of the argument misses");
+    expect(operations().at(symbol_type::ADD)->exec({ one, one }).first == 2 && cacheIs(1, 2, 2), "additions are not cached");
+
+    sine(one);
+    sine(number_t{ 2, 128 });
+    expect(cacheIs(2, 3, 2), "a third sine evicts one");
+    sine(one);
+    expect(cacheIs(3, 3, 2), "the recently used sine stays");
+    sine(number_t{ 1, 256 });
+    expect(cacheIs(3, 4, 2), "the least recently used sine is evicted");
+
+    auto failed = operations().at(symbol_type::SQRT)->exec({ number_t{ -1 } });
+    expect(failed.second == status_type::INVALID_ARGUMENT, "a failing square root fails");
+    expect(operations().at(symbol_type::SQRT)->exec({ number_t{ -1 } }).second == failed.second && cacheIs(4, 5, 2), "a failing square root is cached with its status");
+
+    op_cache::set_capacity(1);
+    expect(cacheIs(4, 5, 1), "lowering the capacity shrinks the cache");
+    op_cache::set_capacity(0);
+    sine(one);
+    sine(one);
+    expect(cacheIs(4, 7, 0), "a cache without capacity stores nothing");
+
+    std::thread other{ []() {
+        sine(number_t{ 3 });
+        expect(cacheIs(0, 1, 1), "another thread has its own cache");
+    } };
+    other.join();
+    expect(op_cache::stats().capacity == 0, "another thread leaves this cache alone");
+
+    op_cache::set_capacity(op_cache::kDefaultCapacity);
+    op_cache::clear();
+}
+
+// Walks the tree by priority the way eval did before it was lowered to a
+// program, counting the most operands held at once across the brackets.
+std::tuple<number_t, status_type, op_ptr> walkTree(const object_t& expr, int prec, size_t& live, size_t& peak) {
+    std::stack<number_t> nums;
+    std::stack<op_ptr> ops;
+
+    auto push = [&](number_t num) {
+        nums.push(std::move(num));
+        peak = std::max(peak, ++live);
+    };
+
+    auto reduce = [&](int priority) -> std::pair<status_type, op_ptr> {
+        while (!ops.empty() && ops.top()->priority() >= priority) {
+            auto op = ops.top(); ops.pop();
+            auto count = static_cast<size_t>(op->category());
+            if (nums.size() < count)
+                return { status_type::INVALID_EVAL, op };
+
+            std::vector<number_t> args(count);
+            for (auto i = count; i-- > 0; --live) {
+                args[i] = nums.top();
+                nums.pop();
+            }
+            auto [res, status] = op->exec(args);
+            if (status != status_type::OK)
+                return { status, op };
+            push(res);
+        }
+        return { status_type::OK, nullptr };
+    };
+
+    for (auto& o : *std::any_cast<std::vector<object_t>>(&expr.value)) {
+        switch (o.type)
+        {
+        case object_type::EXPR:
+            {
+                auto [res, status, op] = walkTree(o, prec, live, peak);
+                if (status != status_type::OK)
+                    return { 0, status, op };
+                push(res);
+            }
+            break;
+        case object_type::OPERAND:
+            push(std::any_cast<constant>(&o.value)->at(prec));
+            break;
+        case object_type::OPERATOR:
+            {
+                auto op = std::any_cast<op_ptr>(o.value);
+                if (auto [status, failed] = reduce(op->priority()); status != status_type::OK)
+                    return { 0, status, failed };
+                ops.push(op);
+            }
+            break;
+        case object_type::VARIABLE:
+            return { 0, status_type::INVALID_EVAL, nullptr };
+        }
+    }
+
+    if (auto [status, failed] = reduce(std::numeric_limits<int>::min()); status != status_type::OK)
+        return { 0, status, failed };
+    if (nums.empty())
+        return { 0, status_type::INVALID_EVAL, nullptr };
+
+    auto res = nums.top();
+    live -= nums.size();
+    return { res, status_type::OK, nullptr };
+}
+
+object_t operandOf(int value) {
+    return { object_type::OPERAND, constant{ number_t{ value } } };
+}
+
+object_t operatorOf(symbol_type type) {
+    return { object_type::OPERATOR, operations().at(type) };
+}
+
+object_t bracketOf(std::vector<object_t> childs) {
+    return { object_type::EXPR, std::move(childs) };
+}
+
+status_type expectProgramMatchesTree(const object_t& obj, int prec, const std::string& what) {
+    size_t live{ 0 }, peak{ 0 };
+    auto walked = walkTree(obj, prec, live, peak);
+    program prog{ obj, prec };
+    expect(sameResult(prog.run(), walked), what + ": the program gives the tree's result");
+    if (std::get<status_type>(walked) == status_type::OK)
+        expect(prog.max_depth() == peak, what + ": the stack is as deep as the tree walk needs");
+    return std::get<status_type>(walked);
+}
+
+void programMatchesTree() {
+    const int prec = 200;
+    for (auto text : {
+        L"1 + 2 x 3 ^ 4",
+        L"2 ^ 3 ^ 2 - 10 % 4",
+        L"((((1 + 2) + 3) + 4) + 5)",
+        L"1 + (2 + (3 + (4 + (5 + 6))))",
+        L"sin(1) + cos(2) x ln(3) / sqrt(2)",
+        L"-(3 - 5)! + 4!",
+        L"PI x E - atan(1) x 4",
+        L"sqrt(-1) + sqrt(-2)",
+        L"1 / 0",
+        L"ln(0) + 1",
+        L"10 ^ 99 x 10 ^ 99",
+        L"acos(2) + asin(2)"
+    }) {
+        std::wstring expr{ text };
+        expectProgramMatchesTree(parsed(expr, prec), prec, std::string(expr.begin(), expr.end()));
+    }
+
+    // trees the parser does not give, lowered to FAIL
+    auto variable = object_t{ object_type::VARIABLE, size_t{ 0 } };
+    expect(expectProgramMatchesTree(bracketOf({ operandOf(1), operatorOf(symbol_type::ADD), variable }), prec, "a variable") == status_type::INVALID_EVAL, "a variable fails");
+    expect(expectProgramMatchesTree(bracketOf({ operatorOf(symbol_type::ADD) }), prec, "an operator without operands") == status_type::INVALID_EVAL, "an operator without operands fails");
+    expect(expectProgramMatchesTree(bracketOf({ operandOf(2), operatorOf(symbol_type::MULT), bracketOf({}) }), prec, "an empty bracket") == status_type::INVALID_EVAL, "an empty bracket fails");
+    auto division = bracketOf({ operandOf(1), operatorOf(symbol_type::DIV), operandOf(0) });
+    expect(expectProgramMatchesTree(bracketOf({ division, operatorOf(symbol_type::ADD), variable }), prec, "a failing value before a variable") != status_type::INVALID_EVAL, "a value fails before a later variable");
+
+    program nested{ parsed(L"1 + (2 + (3 + (4 + 5)))", prec), prec };
+    expect(nested.max_depth() == 5, "right nesting keeps every operand");
+    program chained{ parsed(L"(((1 + 2) + 3) + 4) + 5", prec), prec };
+    expect(chained.max_depth() == 2, "left nesting keeps two operands");
+}
+
+number_t namedConstant(symbol_type name, int prec) {
+    number_t res{ 0, prec };
+    if (name == symbol_type::PI)
+        mpfr_const_pi(res.mpfr_ptr(), MPFR_RNDN);
+    else
+        mpfr_exp(res.mpfr_ptr(), number_t{ 1, prec }.mpfr_srcptr(), MPFR_RNDN);
+    return res;
+}
+
+// Literals are read again from their digits and PI and E rounded at the
+// precision of the evaluation, not widened from what the lexer made.
+void operandsReadAtEvaluationPrecision() {
+    const int prec = 1 << 12;
+    // the editor lexes with 15 digits
+    std::wistringstream source{ L"PI + E + 0.1" };
+    auto [obj, st] = parse(lexer(source, 15));
+    auto& childs = *std::any_cast<std::vector<object_t>>(&obj.value);
+    expect(childs.size() == 5, "the operands parse");
+    if (childs.size() != 5)
+        return;
+
+    auto& pi = *std::any_cast<constant>(&childs[0].value);
+    auto& e = *std::any_cast<constant>(&childs[2].value);
+    auto& tenth = *std::any_cast<constant>(&childs[4].value);
+    expect(pi.at(prec) == namedConstant(symbol_type::PI, prec), "PI is rounded at the evaluation precision");
+    expect(e.at(prec) == namedConstant(symbol_type::E, prec), "E is rounded at the evaluation precision");
+    expect(tenth.at(prec) == number_t{ "0.1", prec }, "a literal is read again at the evaluation precision");
+    expect(pi.exact_precision() == MPFR_PREC_MAX && tenth.exact_precision() == MPFR_PREC_MAX, "named constants and literals are exact at any precision");
+
+    auto [res, status, op] = eval(obj, prec);
+    expect(status == status_type::OK && res == namedConstant(symbol_type::PI, prec) + namedConstant(symbol_type::E, prec) + number_t{ "0.1", prec }, 
+        "the evaluation adds the operands read at its precision");
+
+    auto [sine, sine_status, sine_op] = eval_one(L"sin(PI)", 1 << 10);
+    expect(sine_status == status_type::OK && abs(sine) < number_t{ "1e-300" }, "sin(PI) is as close to zero as the precision allows");
+
+    // a value without digits, like an earlier result, is only widened
+    constant third{ number_t{ 1, 53 } / 3 };
+    auto widened = third.at(prec);
+    expect(third.exact_precision() == 53 && widened.get_prec() == prec && widened == number_t{ 1, 53 } / 3, "a value without digits is widened");
+}
+
+void digitsExpandFromOperandsReadAgain() {
+    const int count = 300;
+    const int prec = digit_expansion::required_precision(count) * 2;
+    std::wistringstream source{ L"PI x 0.1" };
+    digit_expansion expansion{ std::get<0>(parse(lexer(source, 15))) };
+    auto [text, st, op] = expansion.digits(count);
+    expect(st == status_type::OK && text == convert_to_wstring(namedConstant(symbol_type::PI, prec) * number_t{ "0.1", prec }, count), 
+        "deep digits of PI x 0.1 are right");
+
+    // an earlier result, kept at the editor's precision
+    const int result_prec = 1 << 9;
+    object_t result{ object_type::OPERAND, constant{ number_t{ 1, result_prec } / 3 } };
+    digit_expansion capped{ bracketOf({ result }) };
+    auto [capped_text, capped_st, capped_op] = capped.digits(count);
+    expect(digit_expansion::supported_digits(result_prec) < count, "the result backs fewer digits than asked for");
+    expect(capped_st == status_type::OK && capped_text == convert_to_wstring(number_t{ 1, result_prec } / 3, digit_expansion::supported_digits(result_prec)), 
+        "a value without digits caps the digits");
+}
+
+} // namespace
+
+int main() {
+    compiledReadsMultiplicationSignAsVariable();
+    compiledLanesAgree();
+    compiledMpfrMatchesEval();
+    splitEvalMatchesSequential();
+    batchKeepsOrder();
+    batchReportsErrors();
+    opCacheHitsAndEvicts();
+    programMatchesTree();
+    operandsReadAtEvaluationPrecision();
+    digitsExpandFromOperandsReadAgain();
+    return failures ? 1 : 0;
+}
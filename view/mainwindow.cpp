@@ -1,9 +1,11 @@
 #include "mainwindow.hpp"
 #include "./ui_mainwindow.h"
+#include "startupprofile.hpp"
 #include <QDebug>
 #include <QKeyEvent>
 #include <QClipboard>
 #include <QFile>
+#include <QSignalBlocker>
 
 MainWindow::MainWindow(Presenter &presenter, QWidget *parent)
     : QMainWindow(parent)
@@ -13,12 +15,29 @@ MainWindow::MainWindow(Presenter &presenter, QWidget *parent)
     , currentTranslation_{ -1 }
 {
     ui->setupUi(this);
+    StartupProfile::instance().mark("ui setup");
     edit_ = ui->editExpression;
     edit_->installEventFilter(this);
     edit_->setFocusPolicy(Qt::StrongFocus);
     presenter_.setStatusMetrics(QFontMetrics{ ui->statusLabel->font()  });
 
+    // the preview is computed off this thread and shown only while the
+    // expression is still the one it was computed for
+    previewTimer_.setSingleShot(true);
+    previewTimer_.setInterval(kPreviewDelay);
+    QObject::connect(
+        &previewTimer_, &QTimer::timeout,
+        this, [&]() { presenter_.requestStatus(); }
+    );
+    presenter_.setStatusHandler([this](PreviewWorker::Result res) {
+        QMetaObject::invokeMethod(this, [this, res = std::move(res)]() {
+            if (auto st = presenter_.takeStatus(res))
+                ui->statusLabel->setText(*st);
+        }, Qt::QueuedConnection);
+    });
+
     changeLanguage();
+    StartupProfile::instance().mark("translations");
 
     QObject::connect(
         edit_, &QLineEdit::selectionChanged,
@@ -84,6 +103,7 @@ MainWindow::MainWindow(Presenter &presenter, QWidget *parent)
     );
 
     loadStyles();
+    StartupProfile::instance().mark("styles");
 }
 
 QSize MainWindow::sizeHint() const  {
@@ -178,15 +198,24 @@ void MainWindow::changeLanguage() {
 }
 
 void MainWindow::update() {
-    edit_->setText(presenter_.getText());
+    // only the changed part is replaced, so the rest keeps its layout
+    auto diff = presenter_.getTextDiff(edit_->text());
+    if (!diff.empty()) {
+        QSignalBlocker blocker{ edit_ };
+        edit_->setSelection(diff.start, diff.removed);
+        edit_->insert(diff.inserted);
+        // the blocked selectionChanged would have cleared it
+        selection_ = std::nullopt;
+    }
     edit_->setCursorPosition(presenter_.getCursor());
     edit_->setFocus();
-    ui->statusLabel->setText(presenter_.getStatus());
+    previewTimer_.start();
 }
 
 void MainWindow::handleEval() {
     auto st = presenter_.onEval();
     update();
+    previewTimer_.stop();
     ui->statusLabel->setText(st);
 }
 
@@ -214,5 +243,6 @@ void MainWindow::loadStyles() {
 
 MainWindow::~MainWindow()
 {
+    presenter_.setStatusHandler(nullptr);
     delete ui;
 }
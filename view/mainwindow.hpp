@@ -5,6 +5,7 @@
 #include <QPushButton>
 #include <QLineEdit>
 #include <QHash>
+#include <QTimer>
 #include "presenter/presenter.hpp"
 
 QT_BEGIN_NAMESPACE
@@ -44,6 +45,9 @@ private:
     void loadStyles();
 
 private:
+    // keys typed within it share one status preview
+    static constexpr int kPreviewDelay = 30;
+
     static inline QHash<QChar, QChar> symbolBindings_ = {
         { L'*',     L'x'      },
         { L'p',     L'\u03C0' },
@@ -56,6 +60,7 @@ private:
     Presenter &presenter_;
 
     QLineEdit *edit_ = nullptr;
+    QTimer previewTimer_;
     std::optional<std::pair<int, int>> selection_ = std::nullopt;
 
     QStringList translations_;
@@ -0,0 +1,48 @@
+#ifndef STARTUPPROFILE_HPP
+#define STARTUPPROFILE_HPP
+
+#include <vector>
+#include <utility>
+#include <QDebug>
+#include <QElapsedTimer>
+
+// Time from the start of main() to the end of every startup stage, printed
+// once startup is over when CALCULATOR_STARTUP_PROFILE is set.
+class StartupProfile {
+public:
+    static StartupProfile& instance() {
+        static StartupProfile profile;
+        return profile;
+    }
+
+    void mark(const char *stage) {
+        if (enabled_)
+            marks_.push_back({ stage, timer_.nsecsElapsed() });
+    }
+
+    void report() {
+        if (!enabled_ || marks_.empty())
+            return;
+
+        qint64 prev{ 0 };
+        for (auto& [stage, ns] : marks_) {
+            qDebug().nospace() 
+                << "startup: " << stage << " " 
+                << (ns - prev) / 1000 << " us, at " << ns / 1000 << " us";
+            prev = ns;
+        }
+        marks_.clear();
+    }
+
+private:
+    StartupProfile() : enabled_{ qEnvironmentVariableIsSet("CALCULATOR_STARTUP_PROFILE") } {
+        timer_.start();
+    }
+
+private:
+    bool enabled_;
+    QElapsedTimer timer_;
+    std::vector<std::pair<const char*, qint64>> marks_;
+};
+
+#endif // STARTUPPROFILE_HPP